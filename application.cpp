@@ -1,6 +1,8 @@
 
 #include "application.h"
 
+#include <chrono>
+
 void mouse_callback(GLFWwindow *window, f64 xPosIn, f64 yPosIn) {
     const auto xPos = static_cast<float>(xPosIn);
     const auto yPos = static_cast<float>(yPosIn);
@@ -58,44 +60,84 @@ void process_input(GLFWwindow *window, const f32 deltaTime, u32 &inputDelay, boo
     if (inputDelay > 0) inputDelay--;
 }
 
-Application::Application(std::string_view appName, u32 width, u32 height)
+Application::Application(std::string_view appName, u32 width, u32 height, const ApplicationOptions& options)
+    : options(options)
 {
-    context = std::make_unique<Context>(appName, width, height);
+    context = std::make_unique<Context>(appName, width, height, options.headless);
     resourceData = std::make_shared<ResourceData>();
     descriptorBuilder = std::make_unique<DescriptorBuilder>(context->get_device());
-    sceneBuilder = std::make_unique<SceneBuilder>(*context, resourceData);
-    sceneManager = std::make_unique<SceneManager>(resourceData);
-
-    const auto windowP = context->p_get_window();
-    glfwSetCursorPosCallback(windowP, mouse_callback);
-    glfwSetScrollCallback(windowP,  process_scroll);
-    glfwSetInputMode(windowP, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwSetWindowUserPointer(windowP, &context->get_device());
-
-    context->init_imgui();
+    jobSystem = std::make_unique<JobSystem>();
+    sceneBuilder = std::make_unique<SceneBuilder>(*context, *jobSystem, options.sceneImport);
+    sceneManager = std::make_unique<SceneManager>(resourceData, *jobSystem);
+    context->init_worker_commands(jobSystem->get_worker_count());
+
+    gpuProfiler = std::make_unique<GpuProfiler>(
+        context->get_device_handle(), context->get_device().get_timestamp_period(), context->get_device().get_timestamp_valid_bits());
+    for (auto& frame : context->get_command_buffer_infos())
+        frame.commandBuffer.set_profiler(gpuProfiler.get());
+
+    imguiVariables.depthPrepass = options.depthPrepass;
+    imguiVariables.meshShading = options.meshShading && context->get_device().supports_mesh_shading();
+    sceneManager->set_mesh_shading(imguiVariables.meshShading);
+    imguiVariables.triangleCulling = options.triangleCulling;
+    sceneManager->set_triangle_culling(*context, imguiVariables.triangleCulling);
+    imguiVariables.lodErrorThreshold = options.lodErrorThreshold;
+    sceneManager->set_lod_error_threshold(imguiVariables.lodErrorThreshold);
+    imguiVariables.minProjectedSize = options.minProjectedSize;
+    sceneManager->set_min_projected_size(imguiVariables.minProjectedSize);
+
+    if (!options.benchmarkCameraPath.empty())
+        benchmark = std::make_unique<Benchmark>(options.benchmarkCameraPath, options.benchmarkOutput, options.benchmarkFrames, 1.0f / 60.0f);
+
+    if (!options.headless) {
+        const auto windowP = context->p_get_window();
+        glfwSetCursorPosCallback(windowP, mouse_callback);
+        glfwSetScrollCallback(windowP,  process_scroll);
+        glfwSetInputMode(windowP, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        glfwSetWindowUserPointer(windowP, &context->get_device());
+
+        context->init_imgui();
+    }
 
     init();
     run();
 }
 
 Application::~Application() {
+    // A load still in flight owns GPU resources too, publishing it lets them be released below.
+    if (sceneLoad.valid()) {
+        sceneLoad.wait();
+        poll_scene_load();
+    }
+
     const auto deviceHandle = context->get_device_handle();
     auto allocator = context->get_allocator();
     vkDeviceWaitIdle(context->get_device_handle());
     sceneManager->release_gpu_resources(*context);
     descriptorBuilder->release_descriptor_resources();
     deviceHandle.destroyPipeline(opaquePipeline.pipeline);
+    deviceHandle.destroyPipeline(depthPipeline.pipeline);
+    deviceHandle.destroyPipeline(meshletPipeline.pipeline);
+    deviceHandle.destroyPipelineLayout(meshletPipeline.pipelineLayout);
     deviceHandle.destroyPipelineLayout(opaquePipeline.pipelineLayout);
     deviceHandle.destroyDescriptorSetLayout(opaquePipeline.setLayout);
+    deviceHandle.destroyPipeline(cullPipeline.pipeline);
+    deviceHandle.destroyPipelineLayout(cullPipeline.pipelineLayout);
+    deviceHandle.destroyPipeline(triangleCullPipeline.pipeline);
+    deviceHandle.destroyPipelineLayout(triangleCullPipeline.pipelineLayout);
+    deviceHandle.destroyPipeline(depthPyramidPipeline.pipeline);
+    deviceHandle.destroyPipelineLayout(depthPyramidPipeline.pipelineLayout);
 }
 
 void Application::draw()
 {
-    const auto currentFrameTime = static_cast<f32>(glfwGetTime());
-    deltaTime = currentFrameTime - lastFrameTime;
-    lastFrameTime = currentFrameTime;
+    if (!options.headless && !benchmark) {
+        const auto currentFrameTime = static_cast<f32>(glfwGetTime());
+        deltaTime = currentFrameTime - lastFrameTime;
+        lastFrameTime = currentFrameTime;
 
-    process_input(context->p_get_window(), deltaTime, camera.inputDelay, camera.enableMouseLook);
+        process_input(context->p_get_window(), deltaTime, camera.inputDelay, camera.enableMouseLook);
+    }
     SceneData sceneData{};
     sceneData.view = camera.get_view_matrix();
     sceneData.projection = glm::perspective(
@@ -105,9 +147,11 @@ void Application::draw()
         0.1f
         );
     sceneData.cameraPosition = camera.Position;
+    const glm::mat4 viewProjection = sceneData.projection * sceneData.view;
 
 
     context->frame_submit([&](FrameInFlight& cmd, const SwapchainImageData& swapchainData) {
+        const auto cpuStart = std::chrono::steady_clock::now();
         auto& commandBuffer = cmd.commandBuffer;
         const auto& drawImage = context->get_draw_image();
         const auto& depthImage = context->get_depth_image();
@@ -115,32 +159,155 @@ void Application::draw()
         const auto displayExtent = context->get_display_extent();
         const auto drawAttachment = context->get_draw_attachment();
         const auto depthAttachment = context->get_depth_attachment();
+        const u32 frameIndex = context->get_frame_index();
+        const auto& depthPyramidExtent = context->get_depth_pyramid().image.extent;
+        const glm::vec2 depthPyramidSize(depthPyramidExtent.width, depthPyramidExtent.height);
+        const glm::vec2 viewportSize(displayExtent.width, displayExtent.height);
+
+        // The render targets are recreated with the swapchain, so their views have to be written again.
+        if (displayExtent != renderTargetExtent)
+            write_render_targets();
 
         descriptorBuilder->write_buffer(cmd.SceneData.handle, sizeof(SceneData), 0, vk::DescriptorType::eUniformBuffer);
         descriptorBuilder->update_set(opaquePipeline.set);
 
         commandBuffer.begin();
+        gpuProfiler->begin_frame(commandBuffer, cmd.timestampQueryPool, frameIndex);
+        commandBuffer.begin_scope("Frame");
+
+        commandBuffer.begin_scope("Uploads");
+        context->acquire_transfers(commandBuffer);
         commandBuffer.update_uniform(&sceneData, sizeof(SceneData), cmd.SceneData);
+        commandBuffer.end_scope();
+
+        // Until the first scene is published the frame only clears the draw image.
+        sceneManager->set_lod_view(camera.Position, sceneData.projection, viewportSize.y);
+        if (sceneLoaded) {
+            commandBuffer.begin_scope("Culling");
+            sceneManager->cull_scene(commandBuffer, testScene, viewProjection, frameIndex, cullPipeline, depthPyramidSize, viewportSize);
+            commandBuffer.end_scope();
+        }
+        // Shrinks the culled draws to the triangles that can produce a sample before anything is rasterized.
+        const bool triangleCulling = sceneLoaded && sceneManager->triangle_culling_active();
+        if (triangleCulling) {
+            commandBuffer.begin_scope("Triangle Culling");
+            sceneManager->cull_triangles(commandBuffer, frameIndex, triangleCullPipeline);
+            commandBuffer.end_scope();
+        }
+        if (benchmark)
+            complete_benchmark_frame(frameIndex);
+
+        // CPU culling is split into chunks that are culled and recorded into secondary command buffers in parallel.
+        const bool secondaryRecording = sceneLoaded && sceneManager->records_secondary_commands();
+        if (secondaryRecording) {
+            DrawRecordInfo recordInfo;
+            recordInfo.workerCommandBuffers = cmd.workerCommandBuffers;
+            recordInfo.pipeline = &opaquePipeline;
+            recordInfo.extent = displayExtent;
+            recordInfo.colorFormat = static_cast<vk::Format>(drawImage.format);
+            recordInfo.depthFormat = static_cast<vk::Format>(depthImage.format);
+            sceneManager->record_scene(recordInfo, viewProjection, frameIndex);
+        }
 
         commandBuffer.image_barrier(drawImage.handle, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal);
         commandBuffer.image_barrier(depthImage.handle, vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthAttachmentOptimal);
 
-        commandBuffer.set_up_render_pass(displayExtent, &drawAttachment, &depthAttachment);
-        commandBuffer.bind_pipeline(vk::PipelineBindPoint::eGraphics, opaquePipeline);
-        commandBuffer.set_viewport(displayExtent, 0.0f, 1.0f);
-        commandBuffer.set_scissor(displayExtent);
+        // Mesh shading draws the same culled surfaces as meshlets, culling them further against the frustum and their
+        // normal cones.
+        const bool meshShading = sceneLoaded && sceneManager->mesh_shading_active();
+        const Pipeline& scenePipeline = meshShading ? meshletPipeline : opaquePipeline;
+
+        // The prepass draws the same early draws as the opaque pass, which then only shades the nearest fragment of
+        // each pixel. CPU culling records its draws into secondaries for the opaque pipeline only, so it goes without,
+        // and so does mesh shading, whose depth is not guaranteed to match the vertex pipeline's.
+        const bool depthPrepass = sceneLoaded && !secondaryRecording && !meshShading && imguiVariables.depthPrepass;
+        auto opaqueDepthAttachment = depthAttachment;
+        if (depthPrepass) {
+            commandBuffer.begin_scope("Depth Prepass");
+            commandBuffer.set_up_render_pass(displayExtent, nullptr, &depthAttachment);
+            commandBuffer.bind_pipeline(vk::PipelineBindPoint::eGraphics, depthPipeline);
+            commandBuffer.set_viewport(displayExtent, 0.0f, 1.0f);
+            commandBuffer.set_scissor(displayExtent);
+            sceneManager->draw_scene(commandBuffer, frameIndex);
+            commandBuffer.end_render_pass();
+            commandBuffer.end_scope();
+
+            commandBuffer.image_barrier(depthImage.handle, vk::ImageLayout::eDepthAttachmentOptimal, vk::ImageLayout::eDepthAttachmentOptimal);
+            opaqueDepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        }
+
+        commandBuffer.begin_scope("Opaque Pass");
+        commandBuffer.set_up_render_pass(displayExtent, &drawAttachment, &opaqueDepthAttachment,
+            secondaryRecording ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0);
+        if (!secondaryRecording) {
+            commandBuffer.bind_pipeline(vk::PipelineBindPoint::eGraphics, scenePipeline);
+            commandBuffer.set_viewport(displayExtent, 0.0f, 1.0f);
+            commandBuffer.set_scissor(displayExtent);
+        }
 
-        sceneManager->draw_scene(commandBuffer, testScene, sceneData.projection * sceneData.view);
+        if (sceneLoaded)
+            sceneManager->draw_scene(commandBuffer, frameIndex);
 
         commandBuffer.end_render_pass();
+        commandBuffer.end_scope();
+
+        // Second occlusion phase: build Hi-Z from what the early pass drew, then draw whatever it no longer hides.
+        if (sceneLoaded && sceneManager->occlusion_culling_active()) {
+            commandBuffer.image_barrier(depthImage.handle, vk::ImageLayout::eDepthAttachmentOptimal, vk::ImageLayout::eDepthReadOnlyOptimal);
+            commandBuffer.begin_scope("Depth Pyramid");
+            build_depth_pyramid(commandBuffer);
+            commandBuffer.end_scope();
+            commandBuffer.begin_scope("Occlusion Culling");
+            sceneManager->cull_occluded(commandBuffer, frameIndex, cullPipeline);
+            commandBuffer.end_scope();
+            if (triangleCulling) {
+                commandBuffer.begin_scope("Late Triangle Culling");
+                sceneManager->cull_triangles(commandBuffer, frameIndex, triangleCullPipeline, CullPhase::Late);
+                commandBuffer.end_scope();
+            }
+
+            commandBuffer.image_barrier(depthImage.handle, vk::ImageLayout::eDepthReadOnlyOptimal, vk::ImageLayout::eDepthAttachmentOptimal);
+            commandBuffer.image_barrier(drawImage.handle, vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eColorAttachmentOptimal);
+
+            auto lateDrawAttachment = drawAttachment;
+            auto lateDepthAttachment = depthAttachment;
+            lateDrawAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+            lateDepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+            commandBuffer.begin_scope("Late Pass");
+            commandBuffer.set_up_render_pass(displayExtent, &lateDrawAttachment, &lateDepthAttachment);
+            commandBuffer.bind_pipeline(vk::PipelineBindPoint::eGraphics, scenePipeline);
+            commandBuffer.set_viewport(displayExtent, 0.0f, 1.0f);
+            commandBuffer.set_scissor(displayExtent);
+
+            sceneManager->draw_scene(commandBuffer, frameIndex, CullPhase::Late);
+
+            commandBuffer.end_render_pass();
+            commandBuffer.end_scope();
+        }
+
+        // The task shader counts the triangles of the clusters it selects for the Culling panel.
+        if (meshShading)
+            commandBuffer.memory_barrier(
+                vk::PipelineStageFlagBits2::eTaskShaderEXT, vk::AccessFlagBits2::eShaderStorageWrite,
+                vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead);
 
         commandBuffer.image_barrier(drawImage.handle, vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eTransferSrcOptimal);
-        commandBuffer.image_barrier(currentSwapchainImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
 
-        commandBuffer.blit_image(drawImage.handle, currentSwapchainImage, to_extent_3D(displayExtent), to_extent_3D(displayExtent));
-        commandBuffer.image_barrier(currentSwapchainImage, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eColorAttachmentOptimal);
-        draw_imgui(cmd.commandBuffer, swapchainData.swapchainImageView, displayExtent);
-        commandBuffer.image_barrier(currentSwapchainImage, vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::ePresentSrcKHR);
+        // Headless frames end with the draw image ready to be copied out, there is no swapchain image to blit to.
+        if (!options.headless) {
+            commandBuffer.image_barrier(currentSwapchainImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+
+            commandBuffer.begin_scope("Blit");
+            commandBuffer.blit_image(drawImage.handle, currentSwapchainImage, to_extent_3D(displayExtent), to_extent_3D(displayExtent));
+            commandBuffer.end_scope();
+            commandBuffer.image_barrier(currentSwapchainImage, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eColorAttachmentOptimal);
+            commandBuffer.begin_scope("ImGui");
+            draw_imgui(cmd.commandBuffer, swapchainData.swapchainImageView, displayExtent);
+            commandBuffer.end_scope();
+            commandBuffer.image_barrier(currentSwapchainImage, vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::ePresentSrcKHR);
+        }
+        commandBuffer.end_scope();
         commandBuffer.end();
 
         context->submit_work(
@@ -150,37 +317,111 @@ void Application::draw()
             cmd.acquiredSemaphore,
             swapchainData.renderEndSemaphore,
             cmd.renderFence);
+
+        if (benchmark) {
+            const auto& cullingStats = sceneManager->get_culling_stats();
+            BenchmarkFrame frame;
+            frame.frame = benchmarkFrame++;
+            frame.cpuTime = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+            frame.drawCount = cullingStats.cpuVisibleDraws;
+            frame.culledCount = cullingStats.totalDraws - cullingStats.cpuVisibleDraws;
+            pendingBenchmarkFrames[frameIndex] = frame;
+        }
     });
 }
 
+void Application::complete_benchmark_frame(const u32 frameIndex)
+{
+    auto& pending = pendingBenchmarkFrames[frameIndex];
+    if (!pending)
+        return;
+
+    // begin_frame() and cull_scene have just resolved the timestamps and draw counts of the submission that last used
+    // this frame in flight.
+    pending->gpuTime = gpuProfiler->get_resolved_time("Frame");
+    for (const auto& [name, time] : gpuProfiler->get_resolved_scopes())
+        if (name != "Frame")
+            pending->passTimes.emplace_back(name, time);
+    if (sceneManager->get_culling_mode() != CullingMode::CPU) {
+        const auto& cullingStats = sceneManager->get_culling_stats();
+        // gpuVisibleDraws already includes the late phase's draws.
+        pending->drawCount = cullingStats.gpuVisibleDraws;
+        pending->culledCount = cullingStats.totalDraws - pending->drawCount;
+    }
+
+    benchmark->record_frame(*pending);
+    pending.reset();
+}
+
 void Application::draw_imgui(const CommandBuffer &cmd, const vk::ImageView view, const vk::Extent2D extent) {
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
     ImGui::Begin("Scene Settings");
 
+    if (imguiVariables.loadingScene)
+        ImGui::Text("Loading scene...");
+
+    ImGui::Text("Culling");
+    if (ImGui::Combo("Culling Mode", &imguiVariables.cullingMode, "CPU\0GPU\0Validation\0"))
+        sceneManager->set_culling_mode(static_cast<CullingMode>(imguiVariables.cullingMode));
+    if (ImGui::Checkbox("Occlusion Culling", &imguiVariables.occlusionCulling))
+        sceneManager->set_occlusion_culling(imguiVariables.occlusionCulling);
+    ImGui::Checkbox("Depth Prepass", &imguiVariables.depthPrepass);
+    if (context->get_device().supports_mesh_shading() && ImGui::Checkbox("Mesh Shading", &imguiVariables.meshShading))
+        sceneManager->set_mesh_shading(imguiVariables.meshShading);
+    if (ImGui::Checkbox("Triangle Culling", &imguiVariables.triangleCulling)) {
+        sceneManager->set_triangle_culling(*context, imguiVariables.triangleCulling);
+        imguiVariables.triangleCulling = sceneManager->get_triangle_culling();
+    }
+
+    const auto& cullingStats = sceneManager->get_culling_stats();
+    ImGui::Text("Surfaces: %u", cullingStats.totalDraws);
+    ImGui::Text("CPU visible: %u", cullingStats.cpuVisibleDraws);
+    ImGui::Text("GPU visible: %u", cullingStats.gpuVisibleDraws);
+    ImGui::Text("Late visible: %u", cullingStats.lateVisibleDraws);
+    ImGui::Text("Small culled: CPU %u, GPU %u", cullingStats.cpuSmallCulledDraws, cullingStats.gpuSmallCulledDraws);
+    ImGui::Text("Validation mismatches: %u", cullingStats.validationMismatches);
+    if (sceneManager->triangle_culling_active())
+        ImGui::Text("Triangles kept: %u / %u", cullingStats.keptTriangles, cullingStats.testedTriangles);
+    if (sceneManager->get_culling_mode() != CullingMode::CPU)
+        ImGui::Text("LOD triangles: %u / %u", cullingStats.lodTriangles, cullingStats.fullDetailTriangles);
+    if (ImGui::SliderFloat("LOD Error (px)", &imguiVariables.lodErrorThreshold, 0.0f, 8.0f))
+        sceneManager->set_lod_error_threshold(imguiVariables.lodErrorThreshold);
+    if (ImGui::SliderFloat("Min Size (px)", &imguiVariables.minProjectedSize, 0.0f, 8.0f))
+        sceneManager->set_min_projected_size(imguiVariables.minProjectedSize);
+    ImGui::Text("Updated transforms: %u", imguiVariables.updatedTransforms);
+
+    ImGui::Text("GPU Timings");
+    for (const auto& timing : gpuProfiler->get_timings())
+        ImGui::Text("%s: %.3f ms (avg %.3f ms)", timing.name.c_str(), timing.lastTime, timing.averageTime);
+
     ImGui::BeginChild("Light Settings");
     ImGui::Text("Light Settings");
 
-    const auto label = "Lights";
-    ImGui::Combo(label, &imguiVariables.selectedLight, imguiVariables.lightNames, imguiVariables.numLights);
-    Light* currentLight = &imguiVariables.lights[imguiVariables.selectedLight];
+    // Nothing to edit until a scene with lights has been published.
+    if (imguiVariables.lights) {
+        const auto label = "Lights";
+        ImGui::Combo(label, &imguiVariables.selectedLight, imguiVariables.lightNames, imguiVariables.numLights);
+        Light* currentLight = &imguiVariables.lights[imguiVariables.selectedLight];
 
-    if (ImGui::InputFloat3("Position", reinterpret_cast<f32*>(&currentLight->position)))
-        imguiVariables.lightsDirty = true;
+        if (ImGui::InputFloat3("Position", reinterpret_cast<f32*>(&currentLight->position)))
+            imguiVariables.lightsDirty = true;
 
-    if (ImGui::ColorPicker3("Colour", reinterpret_cast<f32*>(&currentLight->colour), ImGuiColorEditFlags_DisplayRGB | ImGuiColorEditFlags_Float))
-        imguiVariables.lightsDirty = true;
+        if (ImGui::ColorPicker3("Colour", reinterpret_cast<f32*>(&currentLight->colour), ImGuiColorEditFlags_DisplayRGB | ImGuiColorEditFlags_Float))
+            imguiVariables.lightsDirty = true;
 
-    if (ImGui::DragFloat("Intensity", &currentLight->intensity, 0.001f, 0.0f, 1.0f))
-        imguiVariables.lightsDirty = true;
+        if (ImGui::DragFloat("Intensity", &currentLight->intensity, 0.001f, 0.0f, 1.0f))
+            imguiVariables.lightsDirty = true;
 
-    if (imguiVariables.lightsDirty) {
-        sceneManager->update_light_buffer(cmd);
-        imguiVariables.lightsDirty = false;
+        if (imguiVariables.lightsDirty) {
+            sceneManager->update_light_buffer(cmd);
+            imguiVariables.lightsDirty = false;
+        }
     }
 
     ImGui::EndChild();
+
     ImGui::End();
     ImGui::Render();
 
@@ -207,6 +448,36 @@ void Application::draw_imgui(const CommandBuffer &cmd, const vk::ImageView view,
 
 void Application::run()
 {
+    if (benchmark) {
+        // The extra frames let the last recorded frames be read back before the results are written.
+        deltaTime = benchmark->get_timestep();
+        const u32 frameCount = benchmark->get_frame_count() + MAX_FRAMES_IN_FLIGHT;
+        for (u32 i = 0; i < frameCount; i++) {
+            if (!options.headless) {
+                glfwPollEvents();
+                if (glfwWindowShouldClose(context->p_get_window()))
+                    break;
+            }
+
+            const auto [time, position, yaw, pitch] = benchmark->sample_camera(i);
+            camera.set_pose(position, yaw, pitch);
+            update();
+            draw();
+        }
+        benchmark->write_results();
+        return;
+    }
+
+    if (options.headless) {
+        // Fixed timestep so headless runs are reproducible.
+        deltaTime = 1.0f / 60.0f;
+        for (u32 i = 0; i < options.headlessFrames; i++) {
+            update();
+            draw();
+        }
+        return;
+    }
+
     while (!glfwWindowShouldClose(context->p_get_window()))
     {
         glfwPollEvents();
@@ -217,15 +488,29 @@ void Application::run()
 
 void Application::update()
 {
-    sceneManager->update_nodes(glm::mat4(1.0f), testScene);
+    poll_scene_load();
+    if (sceneLoaded)
+        imguiVariables.updatedTransforms = sceneManager->update_nodes(glm::mat4(1.0f), testScene);
 }
 
 void Application::init()
 {
-    init_scene_data();
+    sceneLoad = sceneBuilder->load_scene_async(options.scenePath);
+    imguiVariables.loadingScene = true;
+
     init_descriptors();
     init_opaque_pipeline();
-    init_gui_data();
+    init_depth_pipeline();
+    init_meshlet_pipeline();
+    init_cull_pipeline();
+    init_triangle_cull_pipeline();
+    init_depth_pyramid_pipeline();
+
+    // Headless and benchmark runs time the scene itself, so they wait for it instead of rendering the loading frames.
+    if (options.headless || benchmark) {
+        sceneLoad.wait();
+        poll_scene_load();
+    }
 }
 
 void Application::init_opaque_pipeline() {
@@ -250,14 +535,173 @@ void Application::init_opaque_pipeline() {
     context->destroy_shader(fragShader);
 }
 
+void Application::init_depth_pipeline() {
+    const Shader depthShader = context->create_shader("../shaders/bin/slang/depth.slang.spv");
+
+    depthPipeline.setLayout = opaquePipeline.setLayout;
+    depthPipeline.set = opaquePipeline.set;
+    depthPipeline.pipelineLayout = opaquePipeline.pipelineLayout;
+
+    // Same rasterization and depth state as the opaque pipeline so both produce identical depth.
+    PipelineBuilder pipelineBuilder;
+    pipelineBuilder.pipelineLayout = depthPipeline.pipelineLayout;
+    pipelineBuilder.set_vertex_shader(depthShader.module);
+    pipelineBuilder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipelineBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+    pipelineBuilder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
+    pipelineBuilder.set_multisampling_none();
+    pipelineBuilder.enable_depthtest(vk::True, VK_COMPARE_OP_GREATER_OR_EQUAL);
+    pipelineBuilder.set_depth_format(context->get_depth_image().format);
+    depthPipeline.pipeline = pipelineBuilder.build_pipeline(context->get_device());
+
+    context->destroy_shader(depthShader);
+}
+
+void Application::init_meshlet_pipeline() {
+    if (!context->get_device().supports_mesh_shading())
+        return;
+
+    const Shader taskShader = context->create_shader("../shaders/bin/slang/task.slang.spv");
+    const Shader meshShader = context->create_shader("../shaders/bin/slang/mesh.slang.spv");
+    const Shader fragShader = context->create_shader("../shaders/bin/slang/pbr.slang.spv");
+
+    meshletPipeline.setLayout = opaquePipeline.setLayout;
+    meshletPipeline.set = opaquePipeline.set;
+
+    vk::PushConstantRange pcRange(
+        vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT | vk::ShaderStageFlagBits::eFragment,
+        0, sizeof(PushConstants));
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &meshletPipeline.setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pcRange;
+    meshletPipeline.pipelineLayout = context->get_device_handle().createPipelineLayout(pipelineLayoutInfo, nullptr);
+
+    PipelineBuilder pipelineBuilder;
+    pipelineBuilder.pipelineLayout = meshletPipeline.pipelineLayout;
+    pipelineBuilder.set_mesh_shader(taskShader.module, meshShader.module, fragShader.module);
+    pipelineBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+    pipelineBuilder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
+    pipelineBuilder.set_multisampling_none();
+    pipelineBuilder.enable_depthtest(vk::True, VK_COMPARE_OP_GREATER_OR_EQUAL);
+    pipelineBuilder.disable_blending();
+    pipelineBuilder.set_color_attachment_format(context->get_draw_image().format);
+    pipelineBuilder.set_depth_format(context->get_depth_image().format);
+    meshletPipeline.pipeline = pipelineBuilder.build_pipeline(context->get_device());
+
+    context->destroy_shader(taskShader);
+    context->destroy_shader(meshShader);
+    context->destroy_shader(fragShader);
+}
+
+void Application::init_cull_pipeline() {
+    const Shader cullShader = context->create_shader("../shaders/bin/slang/cull.slang.spv");
+
+    vk::PushConstantRange pcRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPushConstants));
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &opaquePipeline.setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pcRange;
+
+    cullPipeline.setLayout = opaquePipeline.setLayout;
+    cullPipeline.set = opaquePipeline.set;
+    cullPipeline.pipelineLayout = context->get_device_handle().createPipelineLayout(pipelineLayoutInfo, nullptr);
+
+    ComputePipelineBuilder pipelineBuilder;
+    pipelineBuilder.pipelineLayout = cullPipeline.pipelineLayout;
+    pipelineBuilder.set_shader(cullShader.module);
+    cullPipeline.pipeline = pipelineBuilder.build_pipeline(context->get_device());
+
+    context->destroy_shader(cullShader);
+}
+
+void Application::init_triangle_cull_pipeline() {
+    const Shader triangleCullShader = context->create_shader("../shaders/bin/slang/trianglecull.slang.spv");
+
+    vk::PushConstantRange pcRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(TriangleCullPushConstants));
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &opaquePipeline.setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pcRange;
+
+    triangleCullPipeline.setLayout = opaquePipeline.setLayout;
+    triangleCullPipeline.set = opaquePipeline.set;
+    triangleCullPipeline.pipelineLayout = context->get_device_handle().createPipelineLayout(pipelineLayoutInfo, nullptr);
+
+    ComputePipelineBuilder pipelineBuilder;
+    pipelineBuilder.pipelineLayout = triangleCullPipeline.pipelineLayout;
+    pipelineBuilder.set_shader(triangleCullShader.module);
+    triangleCullPipeline.pipeline = pipelineBuilder.build_pipeline(context->get_device());
+
+    context->destroy_shader(triangleCullShader);
+}
+
+void Application::init_depth_pyramid_pipeline() {
+    const Shader reduceShader = context->create_shader("../shaders/bin/slang/depthpyramid.slang.spv");
+
+    vk::PushConstantRange pcRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(DepthReducePushConstants));
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &opaquePipeline.setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pcRange;
+
+    depthPyramidPipeline.setLayout = opaquePipeline.setLayout;
+    depthPyramidPipeline.set = opaquePipeline.set;
+    depthPyramidPipeline.pipelineLayout = context->get_device_handle().createPipelineLayout(pipelineLayoutInfo, nullptr);
+
+    ComputePipelineBuilder pipelineBuilder;
+    pipelineBuilder.pipelineLayout = depthPyramidPipeline.pipelineLayout;
+    pipelineBuilder.set_shader(reduceShader.module);
+    depthPyramidPipeline.pipeline = pipelineBuilder.build_pipeline(context->get_device());
+
+    context->destroy_shader(reduceShader);
+}
+
+void Application::write_render_targets() {
+    const auto& depthImage = context->get_depth_image();
+    const auto& depthPyramid = context->get_depth_pyramid();
+
+    descriptorBuilder->write_render_target(DEPTH_RENDER_TARGET, depthImage.view, depthPyramid.sampler, vk::ImageLayout::eDepthReadOnlyOptimal);
+    descriptorBuilder->write_render_target(DEPTH_PYRAMID_RENDER_TARGET, depthPyramid.image.view, depthPyramid.sampler, vk::ImageLayout::eGeneral);
+    for (u32 i = 0; i < depthPyramid.mipViews.size(); i++) {
+        descriptorBuilder->write_render_target(DEPTH_PYRAMID_MIP_RENDER_TARGET + i, depthPyramid.mipViews[i], depthPyramid.sampler, vk::ImageLayout::eGeneral);
+        descriptorBuilder->write_storage_image(i, depthPyramid.mipViews[i]);
+    }
+
+    renderTargetExtent = context->get_display_extent();
+}
+
+void Application::build_depth_pyramid(CommandBuffer &cmd) {
+    const auto& depthPyramid = context->get_depth_pyramid();
+    const auto& pyramidImage = depthPyramid.image;
+
+    cmd.image_barrier(pyramidImage.handle, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
+    cmd.bind_pipeline(vk::PipelineBindPoint::eCompute, depthPyramidPipeline);
+
+    for (u32 mip = 0; mip < pyramidImage.mipLevels; mip++) {
+        DepthReducePushConstants reducePc;
+        reducePc.outputSize = {std::max(pyramidImage.extent.width >> mip, 1u), std::max(pyramidImage.extent.height >> mip, 1u)};
+        reducePc.inputImage = mip == 0 ? DEPTH_RENDER_TARGET : DEPTH_PYRAMID_MIP_RENDER_TARGET + mip - 1;
+        reducePc.outputImage = mip;
+
+        cmd.set_push_constants(&reducePc, sizeof(reducePc), vk::ShaderStageFlagBits::eCompute);
+        cmd.dispatch((reducePc.outputSize.x + 15) / 16, (reducePc.outputSize.y + 15) / 16, 1);
+        cmd.memory_barrier(
+            vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+            vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead
+        );
+    }
+}
+
 void Application::init_descriptors() {
     descriptorBuilder = std::make_unique<DescriptorBuilder>(context->get_device());
     auto globalSet = descriptorBuilder->build(opaquePipeline.setLayout);
     opaquePipeline.set = globalSet;
 
-    sceneBuilder->write_textures(*descriptorBuilder);
-    descriptorBuilder->update_set(opaquePipeline.set);
-
     vk::PushConstantRange pcRange(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(PushConstants));
     vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
 
@@ -270,14 +714,36 @@ void Application::init_descriptors() {
     opaquePipeline.pipelineLayout = globalPipelineLayout;
 }
 
-void Application::init_scene_data() {
-    auto gltf = sceneBuilder->parse_gltf("../assets/scenes/sponza/NewSponza_Main_glTF_003.gltf");
-    if (gltf.has_value())
-        if (const auto scene = sceneBuilder->build_scene(gltf.value()); scene.has_value())
-            testScene = scene.value();
+void Application::poll_scene_load() {
+    if (!sceneLoad.valid() || sceneLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+
+    imguiVariables.loadingScene = false;
+    try {
+        auto loadedScene = sceneLoad.get();
+        publish_scene(loadedScene);
+    }
+    catch (const std::exception& e) {
+        std::println("Failed to load scene: {}", e.what());
+    }
+}
+
+void Application::publish_scene(LoadedScene& loadedScene) {
+    // Frames in flight may still reference the previous scene's buffers and textures.
+    context->get_device_handle().waitIdle();
+    sceneManager->release_gpu_resources(*context);
+
+    *resourceData = std::move(*loadedScene.resourceData);
+    testScene = loadedScene.scene;
+    sceneManager->build_gpu_scene(*context, testScene);
+    sceneManager->write_textures(*descriptorBuilder);
+    descriptorBuilder->update_set(opaquePipeline.set);
+    init_gui_data();
+    sceneLoaded = true;
 }
 
 void Application::init_gui_data() {
+    imguiVariables.selectedLight = 0;
     imguiVariables.lights = sceneManager->get_all_lights_p();
     imguiVariables.lightNames = sceneManager->get_light_names().data();
     i32 numLights = sceneManager->get_num_lights();
@@ -5,6 +5,9 @@
 #include "pipelines/descriptors.h"
 #include "scenes/scenemanager.h"
 #include "camera.h"
+#include "jobsystem.h"
+#include "benchmark.h"
+#include "profiler.h"
 
 
 void mouse_callback(GLFWwindow* window, f64 xPosIn, f64 yPosIn);
@@ -13,17 +16,60 @@ void process_input(GLFWwindow* window, f32 deltaTime, bool& mouseLook);
 
 inline auto camera = Camera(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), -90.0f, 0.0f);
 
+struct DepthReducePushConstants {
+    glm::uvec2 outputSize{};
+    u32 inputImage{};
+    u32 outputImage{};
+};
+
+struct ApplicationOptions {
+    // Renders into the draw image only, without a window, swapchain or ImGui.
+    bool headless = false;
+    u32 headlessFrames = 1000;
+
+    // Plays benchmarkCameraPath back with a fixed timestep and writes per frame timings to benchmarkOutput.
+    std::filesystem::path benchmarkCameraPath;
+    std::filesystem::path benchmarkOutput = "benchmark.csv";
+    u32 benchmarkFrames = 0;
+
+    // glTF or cooked (.wcrs) scene loaded at startup.
+    std::filesystem::path scenePath = "../assets/scenes/sponza/NewSponza_Main_glTF_003.gltf";
+    // Applied to glTF scenes as they are imported, cooked scenes bake them in when cooked.
+    SceneImportOptions sceneImport;
+
+    // Lays down depth with the position only pipeline before the opaque pass. GPU culling modes only.
+    bool depthPrepass = false;
+    // Draws meshlets with the task and mesh shader pipeline when the device supports it. GPU culling modes only.
+    bool meshShading = true;
+    // Culls the triangles of the vertex pipeline's draws into a compacted index buffer. GPU culling modes without
+    // mesh shading only.
+    bool triangleCulling = false;
+    // Projected error in pixels up to which the LOD selection trades detail for triangles.
+    f32 lodErrorThreshold = 1.0f;
+    // Surfaces whose bounding sphere projects to a smaller diameter in pixels are culled.
+    f32 minProjectedSize = 1.0f;
+};
+
 struct ImGUIVariables {
     i32 selectedLight = 0;
     i32 numLights = 0;
-    Light* lights;
+    Light* lights = nullptr;
     char* lightNames = nullptr;
     bool lightsDirty = false;
+    i32 cullingMode = static_cast<i32>(CullingMode::GPU);
+    bool occlusionCulling = true;
+    bool depthPrepass = false;
+    bool meshShading = false;
+    bool triangleCulling = false;
+    f32 lodErrorThreshold = 1.0f;
+    f32 minProjectedSize = 1.0f;
+    u32 updatedTransforms = 0;
+    bool loadingScene = false;
 };
 
 class Application {
 public:
-    Application(std::string_view appName, u32 width, u32 height);
+    Application(std::string_view appName, u32 width, u32 height, const ApplicationOptions& options = {});
     ~Application();
 
     void draw();
@@ -32,18 +78,46 @@ public:
     void update();
     void init();
     void init_opaque_pipeline();
+    void init_depth_pipeline();
+    void init_meshlet_pipeline();
+    void init_cull_pipeline();
+    void init_triangle_cull_pipeline();
+    void init_depth_pyramid_pipeline();
+    void write_render_targets();
+    void build_depth_pyramid(CommandBuffer& cmd);
+    void complete_benchmark_frame(u32 frameIndex);
     void init_descriptors();
-    void init_scene_data();
+    void poll_scene_load();
+    void publish_scene(LoadedScene& loadedScene);
     void init_gui_data();
 
 private:
+    ApplicationOptions options;
     std::unique_ptr<Context> context;
     std::unique_ptr<DescriptorBuilder> descriptorBuilder;
+    std::unique_ptr<JobSystem> jobSystem;
     std::shared_ptr<ResourceData> resourceData;
     std::unique_ptr<SceneBuilder> sceneBuilder;
     std::unique_ptr<SceneManager> sceneManager;
+    std::unique_ptr<GpuProfiler> gpuProfiler;
+    std::unique_ptr<Benchmark> benchmark;
+    // A frame's GPU time and draw counts are read back when its frame in flight is next reused.
+    std::array<std::optional<BenchmarkFrame>, MAX_FRAMES_IN_FLIGHT> pendingBenchmarkFrames;
+    u32 benchmarkFrame = 0;
     SceneHandle testScene{};
+    // Scene being loaded in the background, the previous scene (or nothing) is rendered until it is published.
+    std::future<LoadedScene> sceneLoad;
+    bool sceneLoaded = false;
     Pipeline opaquePipeline;
+    // Shares the opaque pipeline's layout and set.
+    Pipeline depthPipeline;
+    // Shares the opaque set, its layout adds the task and mesh stages to the push constant range. Only created on
+    // devices that support mesh shading.
+    Pipeline meshletPipeline;
+    Pipeline cullPipeline;
+    Pipeline triangleCullPipeline;
+    Pipeline depthPyramidPipeline;
+    vk::Extent2D renderTargetExtent{};
     ImGUIVariables imguiVariables;
 
 };
@@ -0,0 +1,131 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <print>
+#include <ranges>
+#include <sstream>
+
+namespace {
+    // Nearest rank percentile of an already sorted range.
+    f64 percentile(const std::vector<f64>& sorted, const f64 fraction) {
+        if (sorted.empty())
+            return 0.0;
+        const auto rank = static_cast<u64>(std::ceil(fraction * static_cast<f64>(sorted.size())));
+        return sorted[std::clamp<u64>(rank, 1, sorted.size()) - 1];
+    }
+}
+
+Benchmark::Benchmark(const std::filesystem::path& cameraPath, std::filesystem::path outputPath, const u32 frameCount, const f32 timestep)
+    : m_outputPath(std::move(outputPath)), m_frameCount(frameCount), m_timestep(timestep)
+{
+    std::ifstream file(cameraPath);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open camera path " + cameraPath.string());
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream stream(line);
+        CameraKeyframe keyframe;
+        if (!(stream >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.yaw >> keyframe.pitch))
+            throw std::runtime_error("Malformed camera path keyframe: " + line);
+        if (!m_keyframes.empty() && keyframe.time < m_keyframes.back().time)
+            throw std::runtime_error("Camera path keyframes must be sorted by time");
+
+        m_keyframes.push_back(keyframe);
+    }
+
+    if (m_keyframes.empty())
+        throw std::runtime_error("Camera path " + cameraPath.string() + " has no keyframes");
+
+    if (m_frameCount == 0)
+        m_frameCount = static_cast<u32>(std::ceil(m_keyframes.back().time / m_timestep)) + 1;
+    m_frames.reserve(m_frameCount);
+}
+
+CameraKeyframe Benchmark::sample_camera(const u32 frame) const {
+    const f32 time = static_cast<f32>(frame) * m_timestep;
+
+    const auto next = std::ranges::upper_bound(m_keyframes, time, {}, &CameraKeyframe::time);
+    if (next == m_keyframes.begin())
+        return m_keyframes.front();
+    if (next == m_keyframes.end())
+        return m_keyframes.back();
+
+    const auto& a = *(next - 1);
+    const auto& b = *next;
+    const f32 t = (time - a.time) / (b.time - a.time);
+
+    CameraKeyframe keyframe;
+    keyframe.time = time;
+    keyframe.position = glm::mix(a.position, b.position, t);
+    keyframe.yaw = glm::mix(a.yaw, b.yaw, t);
+    keyframe.pitch = glm::mix(a.pitch, b.pitch, t);
+    return keyframe;
+}
+
+void Benchmark::record_frame(const BenchmarkFrame& frame) {
+    if (frame.frame < m_frameCount)
+        m_frames.push_back(frame);
+}
+
+void Benchmark::write_results() {
+    std::ranges::sort(m_frames, {}, &BenchmarkFrame::frame);
+
+    std::ofstream file(m_outputPath);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open benchmark output " + m_outputPath.string());
+
+    // Pass columns in the order they first appear.
+    std::vector<std::string> passNames;
+    for (const auto& frame : m_frames)
+        for (const auto& name : frame.passTimes | std::views::keys)
+            if (std::ranges::find(passNames, name) == passNames.end())
+                passNames.push_back(name);
+
+    // Column 0 is the CPU time, 1 the GPU time and the rest follow passNames.
+    std::vector<std::vector<f64>> columns(passNames.size() + 2);
+    for (auto& column : columns)
+        column.reserve(m_frames.size());
+
+    file << "frame,cpu_ms,gpu_ms,draws,culled";
+    for (const auto& name : passNames)
+        file << ',' << name << "_ms";
+    file << '\n';
+
+    for (const auto& [frame, cpuTime, gpuTime, drawCount, culledCount, passTimes] : m_frames) {
+        std::print(file, "{},{:.4f},{:.4f},{},{}", frame, cpuTime, gpuTime, drawCount, culledCount);
+        columns[0].push_back(cpuTime);
+        columns[1].push_back(gpuTime);
+
+        for (u64 i = 0; i < passNames.size(); i++) {
+            const auto pass = std::ranges::find(passTimes, passNames[i], &std::pair<std::string, f64>::first);
+            const f64 time = pass != passTimes.end() ? pass->second : 0.0;
+            std::print(file, ",{:.4f}", time);
+            columns[i + 2].push_back(time);
+        }
+        file << '\n';
+    }
+
+    for (auto& column : columns)
+        std::ranges::sort(column);
+
+    file << "\nstatistic,cpu_ms,gpu_ms";
+    for (const auto& name : passNames)
+        file << ',' << name << "_ms";
+    file << '\n';
+
+    std::println("Benchmark: {} frames written to {}", m_frames.size(), m_outputPath.string());
+    for (const auto& [name, fraction] : {std::pair{"p50", 0.50}, std::pair{"p95", 0.95}, std::pair{"p99", 0.99}}) {
+        file << name;
+        for (const auto& column : columns)
+            std::print(file, ",{:.4f}", percentile(column, fraction));
+        file << '\n';
+
+        std::println("{} cpu {:.4f} ms, gpu {:.4f} ms", name, percentile(columns[0], fraction), percentile(columns[1], fraction));
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "common.h"
+#include "glmdefines.h"
+
+#include <glm/glm.hpp>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct CameraKeyframe {
+    f32 time{};
+    glm::vec3 position{};
+    f32 yaw{};
+    f32 pitch{};
+};
+
+struct BenchmarkFrame {
+    u32 frame{};
+    f64 cpuTime{};
+    f64 gpuTime{};
+    u32 drawCount{};
+    u32 culledCount{};
+    // GPU time of every profiler scope resolved for the frame, written as extra CSV columns.
+    std::vector<std::pair<std::string, f64>> passTimes;
+};
+
+// Plays a recorded camera path back at a fixed timestep and collects per frame timings. Camera paths are text files
+// with one "time x y z yaw pitch" keyframe per line, sorted by time; lines starting with '#' are ignored.
+class Benchmark {
+public:
+    // A frameCount of 0 runs until the last keyframe is reached.
+    Benchmark(const std::filesystem::path& cameraPath, std::filesystem::path outputPath, u32 frameCount, f32 timestep);
+
+    [[nodiscard]] CameraKeyframe sample_camera(u32 frame) const;
+    [[nodiscard]] u32 get_frame_count() const { return m_frameCount; }
+    [[nodiscard]] f32 get_timestep() const { return m_timestep; }
+
+    void record_frame(const BenchmarkFrame& frame);
+    // Writes every recorded frame followed by p50/p95/p99 rows to the output CSV and prints the summary. Passes missing
+    // from a frame are written as 0.
+    void write_results();
+
+private:
+    std::vector<CameraKeyframe> m_keyframes;
+    std::vector<BenchmarkFrame> m_frames;
+    std::filesystem::path m_outputPath;
+    u32 m_frameCount{};
+    f32 m_timestep{};
+};
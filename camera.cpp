@@ -68,6 +68,13 @@ void Camera::process_keyboard(Camera_Movement direction, f32 deltaTime) {
         Position -= WorldUp * velocity;
 }
 
+void Camera::set_pose(const glm::vec3& position, const f32 _yaw, const f32 _pitch) {
+    Position = position;
+    yaw = _yaw;
+    pitch = _pitch;
+    update_camera_vectors();
+}
+
 void Camera::update_camera_vectors() {
     glm::vec3 front;
     front.x = cosf(glm::radians(yaw)) * cosf(glm::radians(pitch));
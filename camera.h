@@ -56,6 +56,7 @@ public:
     void process_mouse_scroll(f32 yOffset);
     void process_mouse_movement(f32 xOffset, f32 yOffset, bool constrainPitch);
     void process_keyboard(Camera_Movement direction, f32 deltaTime);
+    void set_pose(const glm::vec3& position, f32 _yaw, f32 _pitch);
 
 private:
     void update_camera_vectors();
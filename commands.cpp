@@ -1,5 +1,17 @@
-
 #include "commands.h"
+#include "profiler.h"
+
+namespace {
+    PFN_vkCmdDrawMeshTasksIndirectCountEXT drawMeshTasksIndirectCount = nullptr;
+}
+
+void CommandBuffer::load_mesh_shader_functions(const vk::Device device)
+{
+    drawMeshTasksIndirectCount = reinterpret_cast<PFN_vkCmdDrawMeshTasksIndirectCountEXT>(
+        device.getProcAddr("vkCmdDrawMeshTasksIndirectCountEXT"));
+    if (!drawMeshTasksIndirectCount)
+        throw std::runtime_error("Failed to load vkCmdDrawMeshTasksIndirectCountEXT");
+}
 
 void CommandBuffer::begin() const
 {
@@ -8,11 +20,36 @@ void CommandBuffer::begin() const
     vk_check(cmd.begin(&beginInfo), "Failed to begin command buffer");
 }
 
+void CommandBuffer::begin_secondary(const vk::Format colorFormat, const vk::Format depthFormat) const
+{
+    cmd.reset();
+
+    vk::CommandBufferInheritanceRenderingInfo renderingInheritance;
+    renderingInheritance.colorAttachmentCount = 1;
+    renderingInheritance.pColorAttachmentFormats = &colorFormat;
+    renderingInheritance.depthAttachmentFormat = depthFormat;
+    renderingInheritance.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+    vk::CommandBufferInheritanceInfo inheritanceInfo;
+    inheritanceInfo.pNext = &renderingInheritance;
+
+    const vk::CommandBufferBeginInfo beginInfo(
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+        &inheritanceInfo);
+    vk_check(cmd.begin(&beginInfo), "Failed to begin secondary command buffer");
+}
+
 void CommandBuffer::end() const
 {
     cmd.end();
 }
 
+void CommandBuffer::execute_commands(const std::span<const vk::CommandBuffer> commandBuffers) const
+{
+    if (!commandBuffers.empty())
+        cmd.executeCommands(static_cast<u32>(commandBuffers.size()), commandBuffers.data());
+}
+
 void CommandBuffer::image_barrier(const vk::Image image, const vk::ImageLayout currentLayout, const vk::ImageLayout newLayout) const
 {
     vk::ImageMemoryBarrier2 imageBarrier(
@@ -23,7 +60,10 @@ void CommandBuffer::image_barrier(const vk::Image image, const vk::ImageLayout c
     imageBarrier.oldLayout = currentLayout;
     imageBarrier.newLayout = newLayout;
 
-    const auto aspectMask = newLayout == vk::ImageLayout::eDepthAttachmentOptimal ? vk::ImageAspectFlagBits::eDepth : vk::ImageAspectFlagBits::eColor;
+    const auto is_depth_layout = [](const vk::ImageLayout layout) {
+        return layout == vk::ImageLayout::eDepthAttachmentOptimal || layout == vk::ImageLayout::eDepthReadOnlyOptimal;
+    };
+    const auto aspectMask = is_depth_layout(currentLayout) || is_depth_layout(newLayout) ? vk::ImageAspectFlagBits::eDepth : vk::ImageAspectFlagBits::eColor;
     imageBarrier.subresourceRange = vk::ImageSubresourceRange(
         aspectMask,
         0,
@@ -84,6 +124,21 @@ void CommandBuffer::memory_barrier(
     cmd.pipelineBarrier2(&dependencyInfo);
 }
 
+void CommandBuffer::pipeline_barrier(
+    const std::span<const vk::ImageMemoryBarrier2> imageBarriers,
+    const std::span<const vk::BufferMemoryBarrier2> bufferBarriers) const
+{
+    if (imageBarriers.empty() && bufferBarriers.empty())
+        return;
+
+    vk::DependencyInfo dependencyInfo;
+    dependencyInfo.imageMemoryBarrierCount = static_cast<u32>(imageBarriers.size());
+    dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+    dependencyInfo.bufferMemoryBarrierCount = static_cast<u32>(bufferBarriers.size());
+    dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+    cmd.pipelineBarrier2(&dependencyInfo);
+}
+
 void CommandBuffer::blit_image(const vk::Image src, const vk::Image dst, const vk::Extent3D srcSize, const vk::Extent3D dstSize) const
 {
     vk::ImageBlit2 blitRegion;
@@ -119,6 +174,11 @@ void CommandBuffer::blit_image(const vk::Image src, const vk::Image dst, const v
     cmd.blitImage2(&blitInfo);
 }
 
+void CommandBuffer::fill_buffer(const Buffer& buffer, const vk::DeviceSize offset, const vk::DeviceSize size, const u32 data) const
+{
+    cmd.fillBuffer(buffer.handle, offset, size, data);
+}
+
 void CommandBuffer::copy_buffer(
     const Buffer& bufferSrc, const Buffer& bufferDst,
     const vk::DeviceSize srcOffset, const vk::DeviceSize dstOffset,
@@ -219,19 +279,48 @@ void CommandBuffer::dispatch(const u32 groupCountX, const u32 groupCountY, const
     cmd.dispatch(groupCountX, groupCountY, groupCountZ);
 }
 
+void CommandBuffer::dispatch_indirect(const Buffer& buffer, const vk::DeviceSize offset) const
+{
+    cmd.dispatchIndirect(buffer.handle, offset);
+}
+
+void CommandBuffer::reset_query_pool(const vk::QueryPool queryPool, const u32 firstQuery, const u32 queryCount) const
+{
+    cmd.resetQueryPool(queryPool, firstQuery, queryCount);
+}
+
+void CommandBuffer::write_timestamp(const vk::PipelineStageFlags2 stage, const vk::QueryPool queryPool, const u32 query) const
+{
+    cmd.writeTimestamp2(stage, queryPool, query);
+}
+
+void CommandBuffer::begin_scope(const std::string_view name) const
+{
+    if (profiler)
+        profiler->begin_scope(*this, name);
+}
+
+void CommandBuffer::end_scope() const
+{
+    if (profiler)
+        profiler->end_scope(*this);
+}
+
 void CommandBuffer::set_up_render_pass(
     const vk::Extent2D extent,
     const VkRenderingAttachmentInfo* drawImage,
-    const VkRenderingAttachmentInfo* depthImage) const
+    const VkRenderingAttachmentInfo* depthImage,
+    const VkRenderingFlags flags) const
 {
     vk::Rect2D renderArea;
     renderArea.extent = extent;
     VkRenderingInfo renderInfo{.sType = VK_STRUCTURE_TYPE_RENDERING_INFO, .pNext = nullptr};
+    renderInfo.flags = flags;
     renderInfo.renderArea = renderArea;
     renderInfo.pColorAttachments = drawImage;
     renderInfo.pDepthAttachment = depthImage;
     renderInfo.layerCount = 1;
-    renderInfo.colorAttachmentCount = 1;
+    renderInfo.colorAttachmentCount = drawImage ? 1 : 0;
 
     vkCmdBeginRendering(cmd, &renderInfo);
 }
@@ -276,9 +365,9 @@ void CommandBuffer::set_scissor(const vk::Extent2D extent) const
     cmd.setScissor(0, 1, &scissor);
 }
 
-void CommandBuffer::bind_index_buffer(const Buffer& indexBuffer) const
+void CommandBuffer::bind_index_buffer(const Buffer& indexBuffer, const vk::IndexType indexType) const
 {
-    cmd.bindIndexBuffer(indexBuffer.handle, 0, vk::IndexType::eUint32);
+    cmd.bindIndexBuffer(indexBuffer.handle, 0, indexType);
 }
 
 void CommandBuffer::bind_vertex_buffer(const Buffer& vertexBuffer) const
@@ -293,9 +382,31 @@ void CommandBuffer::set_push_constants(const void* pPushConstants, u64 size,
     cmd.pushConstants(pipeline.pipelineLayout, shaderStage, 0, size, pPushConstants);
 }
 
-void CommandBuffer::draw(const u32 count, const u32 startIndex) const
+void CommandBuffer::draw(const u32 count, const u32 startIndex, const i32 vertexOffset) const
+{
+    cmd.drawIndexed(count, 1, startIndex, vertexOffset, 0);
+}
+
+void CommandBuffer::draw_indexed_indirect(const Buffer& drawBuffer, const vk::DeviceSize offset, const u32 drawCount, const u32 stride) const
+{
+    cmd.drawIndexedIndirect(drawBuffer.handle, offset, drawCount, stride);
+}
+
+void CommandBuffer::draw_indexed_indirect_count(
+    const Buffer& drawBuffer, const vk::DeviceSize offset,
+    const Buffer& countBuffer, const vk::DeviceSize countOffset,
+    const u32 maxDrawCount, const u32 stride) const
+{
+    cmd.drawIndexedIndirectCount(drawBuffer.handle, offset, countBuffer.handle, countOffset, maxDrawCount, stride);
+}
+
+void CommandBuffer::draw_mesh_tasks_indirect_count(
+    const Buffer& taskBuffer, const vk::DeviceSize offset,
+    const Buffer& countBuffer, const vk::DeviceSize countOffset,
+    const u32 maxDrawCount, const u32 stride) const
 {
-    cmd.drawIndexed(count, 1, startIndex, 0, 0);
+    assert(drawMeshTasksIndirectCount);
+    drawMeshTasksIndirectCount(cmd, taskBuffer.handle, offset, countBuffer.handle, countOffset, maxDrawCount, stride);
 }
 
 void CommandBuffer::bind_pipeline(vk::PipelineBindPoint bindPoint, const Pipeline &_pipeline) {
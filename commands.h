@@ -2,10 +2,14 @@
 #include "common.h"
 #include "device/resourcetypes.h"
 
+class GpuProfiler;
+
 class CommandBuffer {
 public:
     void begin() const;
+    void begin_secondary(vk::Format colorFormat, vk::Format depthFormat) const;
     void end() const;
+    void execute_commands(std::span<const vk::CommandBuffer> commandBuffers) const;
 
     void image_barrier(vk::Image image, vk::ImageLayout currentLayout, vk::ImageLayout newLayout) const;
     void buffer_barrier(
@@ -20,8 +24,13 @@ public:
     void memory_barrier(
     vk::PipelineStageFlags2 srcStageFlags, vk::AccessFlags2 srcAccessMask,
     vk::PipelineStageFlags2 dstStageFlags, vk::AccessFlags2 dstAccessMask) const;
+    // Records prebuilt barriers in a single dependency, used for queue family ownership transfers.
+    void pipeline_barrier(
+        std::span<const vk::ImageMemoryBarrier2> imageBarriers,
+        std::span<const vk::BufferMemoryBarrier2> bufferBarriers) const;
 
     void blit_image(vk::Image src, vk::Image dst, vk::Extent3D srcSize, vk::Extent3D dstSize) const;
+    void fill_buffer(const Buffer &buffer, vk::DeviceSize offset, vk::DeviceSize size, u32 data) const;
     void copy_buffer(const Buffer &bufferSrc, const Buffer &bufferDst, vk::DeviceSize srcOffset, vk::DeviceSize dstOffset, vk::DeviceSize dataSize) const;
     void copy_buffer_to_image(const Buffer& buffer, const Image& image, vk::ImageLayout layout, const std::span<vk::BufferImageCopy>& regions) const;
 
@@ -30,21 +39,42 @@ public:
     void update_uniform(const void* data, u64 dataSize, const Buffer& uniform) const;
 
     void dispatch(u32 groupCountX, u32 groupCountY, u32 groupCountZ) const;
+    void dispatch_indirect(const Buffer& buffer, vk::DeviceSize offset) const;
+
+    void reset_query_pool(vk::QueryPool queryPool, u32 firstQuery, u32 queryCount) const;
+    void write_timestamp(vk::PipelineStageFlags2 stage, vk::QueryPool queryPool, u32 query) const;
+    // Named GPU timing scopes, ignored unless a profiler has been attached with set_profiler().
+    void begin_scope(std::string_view name) const;
+    void end_scope() const;
 
-    void set_up_render_pass(vk::Extent2D extent, const VkRenderingAttachmentInfo* drawImage, const VkRenderingAttachmentInfo* depthImage) const;
+    void set_up_render_pass(vk::Extent2D extent, const VkRenderingAttachmentInfo* drawImage, const VkRenderingAttachmentInfo* depthImage, VkRenderingFlags flags = 0) const;
     void end_render_pass() const;
     void set_viewport(f32 x, f32 y, f32 minDepth, f32 maxDepth) const;
     void set_viewport(vk::Extent2D extent, f32 minDepth, f32 maxDepth) const;
     void set_scissor(u32 x, u32 y) const;
     void set_scissor(vk::Extent2D extent) const;
-    void bind_index_buffer(const Buffer &indexBuffer) const;
+    void bind_index_buffer(const Buffer &indexBuffer, vk::IndexType indexType) const;
     void bind_vertex_buffer(const Buffer &vertexBuffer) const;
     void set_push_constants(const void *pPushConstants, u64 size, const vk::ShaderStageFlags shaderStage) const;
-    void draw(u32 count, u32 startIndex) const;
+    void draw(u32 count, u32 startIndex, i32 vertexOffset) const;
+    void draw_indexed_indirect(const Buffer& drawBuffer, vk::DeviceSize offset, u32 drawCount, u32 stride) const;
+    void draw_indexed_indirect_count(
+        const Buffer& drawBuffer, vk::DeviceSize offset,
+        const Buffer& countBuffer, vk::DeviceSize countOffset,
+        u32 maxDrawCount, u32 stride) const;
+    // Requires EXT_mesh_shader and load_mesh_shader_functions() to have been called for the device.
+    void draw_mesh_tasks_indirect_count(
+        const Buffer& taskBuffer, vk::DeviceSize offset,
+        const Buffer& countBuffer, vk::DeviceSize countOffset,
+        u32 maxDrawCount, u32 stride) const;
+
+    // Extension commands are not exported by the loader and have to be fetched per device.
+    static void load_mesh_shader_functions(vk::Device device);
 
     void set_handle(const vk::CommandBuffer& _cmd) { cmd = _cmd; }
     void bind_pipeline(vk::PipelineBindPoint bindPoint, const Pipeline& _pipeline);
     void set_allocator(const VmaAllocator& _allocator) { allocator = _allocator; }
+    void set_profiler(GpuProfiler* _profiler) { profiler = _profiler; }
 
     [[nodiscard]] vk::CommandBuffer get_handle() const { return cmd; }
 
@@ -57,4 +87,5 @@ private:
     Pipeline pipeline{};
     vk::CommandBuffer cmd{};
     VmaAllocator allocator{};
+    GpuProfiler* profiler = nullptr;
 };
@@ -3,7 +3,8 @@
 
 #include "simdjson.h"
 
-Context::Context(std::string_view appName, u32 width, u32 height) : m_Device(std::make_unique<Device>(appName, width, height))
+Context::Context(std::string_view appName, u32 width, u32 height, const bool headless)
+    : m_Device(std::make_unique<Device>(appName, width, height, headless))
 {
     for (auto& infos = get_command_buffer_infos(); auto& info : infos) {
         info.SceneData = create_buffer(
@@ -27,6 +28,11 @@ Context::~Context()
 
 void Context::frame_submit(const std::function<void(FrameInFlight& cmd, SwapchainImageData& swapchainData)>&& func)
 {
+    if (m_Device->is_headless()) {
+        headless_frame_submit(func);
+        return;
+    }
+
     const auto deviceHandle = m_Device->get_handle();
     if (auto currentExtent = get_display_extent(); currentExtent != previousSwapchainExtent)
     {
@@ -66,7 +72,11 @@ void Context::frame_submit(const std::function<void(FrameInFlight& cmd, Swapchai
     func(fif, swapchainData);
 
     const vk::PresentInfoKHR presentInfo(1, &swapchainData.renderEndSemaphore, 1, &swapchain, &swapchainImageIndex);
-    if (result = get_graphic_queue().presentKHR(presentInfo); swapchain_need_recreation(result))
+    {
+        std::scoped_lock lock(m_queueMutex);
+        result = get_graphic_queue().presentKHR(presentInfo);
+    }
+    if (swapchain_need_recreation(result))
     {
         fif.resizeRequested = true;
         return;
@@ -75,6 +85,28 @@ void Context::frame_submit(const std::function<void(FrameInFlight& cmd, Swapchai
     frameNumber++;
 }
 
+void Context::headless_frame_submit(const std::function<void(FrameInFlight& cmd, SwapchainImageData& swapchainData)>& func)
+{
+    // No swapchain image is acquired or presented, the frame only renders into the draw image. The swapchain data
+    // handed to func is empty, so submit_work skips its semaphores.
+    const auto deviceHandle = m_Device->get_handle();
+    auto& fif = m_Device->commandBufferInfos[frameNumber % MAX_FRAMES_IN_FLIGHT];
+
+    vk_check(
+        deviceHandle.waitForFences(1, &fif.renderFence, true, UINT64_MAX),
+        "Failed to wait for fences!"
+    );
+    vk_check(
+        deviceHandle.resetFences(1, &fif.renderFence),
+        "Failed to reset render fences!"
+    );
+
+    SwapchainImageData swapchainData{};
+    func(fif, swapchainData);
+
+    frameNumber++;
+}
+
 Buffer Context::create_buffer(
     const u64 allocationSize,
     vk::BufferUsageFlags usage,
@@ -242,23 +274,36 @@ void Context::submit_work(const CommandBuffer &cmd,
                           const vk::PipelineStageFlagBits2 signal,
                           const vk::Semaphore acquiredSemaphore,
                           const vk::Semaphore renderEndSemaphore,
-                          const vk::Fence renderFence) const
+                          const vk::Fence renderFence)
 {
     const vk::CommandBuffer handle = cmd.get_handle();
     const vk::CommandBufferSubmitInfo commandBufferSI(handle);
 
-    vk::SemaphoreSubmitInfo waitInfo(acquiredSemaphore);
-    waitInfo.stageMask = wait;
+    // Headless frames have no swapchain semaphores to wait on or signal.
+    std::array<vk::SemaphoreSubmitInfo, 2> waitInfos;
+    u32 waitCount = 0;
+    if (acquiredSemaphore) {
+        waitInfos[waitCount] = vk::SemaphoreSubmitInfo(acquiredSemaphore);
+        waitInfos[waitCount++].stageMask = wait;
+    }
+    // Transfers acquired by this command buffer must have finished on the transfer queue first.
+    if (m_graphicsWaitValue != 0) {
+        waitInfos[waitCount] = vk::SemaphoreSubmitInfo(m_Device->get_transfer_timeline(), m_graphicsWaitValue);
+        waitInfos[waitCount++].stageMask = vk::PipelineStageFlagBits2::eAllCommands;
+        m_graphicsWaitValue = 0;
+    }
+
     vk::SemaphoreSubmitInfo signalInfo(renderEndSemaphore);
     signalInfo.stageMask = signal;
 
     constexpr vk::SubmitFlagBits submitFlags{};
     const vk::SubmitInfo2 submitInfo(
         submitFlags,
-        1, &waitInfo,
+        waitCount, waitInfos.data(),
         1, &commandBufferSI,
-        1, &signalInfo);
+        renderEndSemaphore ? 1 : 0, &signalInfo);
 
+    std::scoped_lock lock(m_queueMutex);
     const auto graphicsQueue = m_Device->get_graphics_queue();
     vk_check(
         graphicsQueue.submit2(1, &submitInfo, renderFence),
@@ -266,59 +311,69 @@ void Context::submit_work(const CommandBuffer &cmd,
         );
 }
 
-void Context::submit_upload_work() const
+u64 Context::submit_transfer_work(const CommandBuffer& cmd)
 {
-    const auto deviceHandle = m_Device->get_handle();
-    const auto [immFence, immPool, immCmd] = m_Device->get_immediate_info();
-    CommandBuffer cmd;
-    cmd.set_handle(immCmd);
-    cmd.set_allocator(m_Device->get_allocator());
+    const vk::CommandBufferSubmitInfo commandBufferSI(cmd.get_handle());
 
-    vk_check(deviceHandle.waitForFences(1, &immFence, true, UINT64_MAX), "Failed to wait for fences");
-    vk_check(deviceHandle.resetFences(1, &immFence), "Failed to reset fences");
+    std::scoped_lock lock(m_queueMutex);
+    const u64 signalValue = ++m_transferTimelineValue;
+    vk::SemaphoreSubmitInfo signalInfo(m_Device->get_transfer_timeline(), signalValue);
+    signalInfo.stageMask = vk::PipelineStageFlagBits2::eAllCommands;
 
-    vk::CommandBufferSubmitInfo commandBufferSI(cmd.get_handle());
-    const vk::SubmitInfo2 submitInfo({}, nullptr, commandBufferSI);
+    const vk::SubmitInfo2 submitInfo({}, 0, nullptr, 1, &commandBufferSI, 1, &signalInfo);
 
-    const auto graphicsQueue = m_Device->get_graphics_queue();
+    const auto transferQueue = m_Device->get_transferQueue();
     vk_check(
-        graphicsQueue.submit2(1, &submitInfo, immFence),
-        "Failed to submit immediate upload commands"
+        transferQueue.submit2(1, &submitInfo, nullptr),
+        "Failed to submit transfer commands"
         );
 
-    vk_check(
-        m_Device->get_handle().waitForFences(1, &immFence, true, UINT64_MAX),
-        "Failed to wait for fences"
-        );
+    return signalValue;
 }
 
-void Context::submit_immediate_work(std::function<void(CommandBuffer)> &&function) const {
-    const auto deviceHandle = m_Device->get_handle();
-    const auto [immFence, immPool, immCmd] = m_Device->get_immediate_info();
-    CommandBuffer cmd;
-    cmd.set_handle(immCmd);
-    cmd.set_allocator(m_Device->get_allocator());
+void Context::wait_for_transfer(const u64 timelineValue) const
+{
+    if (timelineValue == 0)
+        return;
 
-    vk_check(deviceHandle.resetFences(1, &immFence), "Failed to reset fences");
+    const vk::Semaphore timeline = m_Device->get_transfer_timeline();
+    const vk::SemaphoreWaitInfo waitInfo({}, 1, &timeline, &timelineValue);
+    vk_check(
+        m_Device->get_handle().waitSemaphores(&waitInfo, UINT64_MAX),
+        "Failed to wait for transfer timeline"
+        );
+}
 
-    cmd.begin();
-    function(cmd);
-    cmd.end();
+void Context::enqueue_acquire(
+    const u64 timelineValue,
+    const std::span<const vk::ImageMemoryBarrier2> imageBarriers,
+    const std::span<const vk::BufferMemoryBarrier2> bufferBarriers)
+{
+    std::scoped_lock lock(m_acquireMutex);
+    m_pendingImageAcquires.insert(m_pendingImageAcquires.end(), imageBarriers.begin(), imageBarriers.end());
+    m_pendingBufferAcquires.insert(m_pendingBufferAcquires.end(), bufferBarriers.begin(), bufferBarriers.end());
+    m_pendingAcquireValue = std::max(m_pendingAcquireValue, timelineValue);
+}
 
-    const vk::CommandBufferSubmitInfo commandBufferSI(cmd.get_handle());
-    vk::SubmitInfo2 submitInfo({}, nullptr, nullptr);
-    submitInfo.pCommandBufferInfos = &commandBufferSI;
+void Context::acquire_transfers(const CommandBuffer& cmd)
+{
+    std::scoped_lock lock(m_acquireMutex);
+    if (m_pendingAcquireValue == 0)
+        return;
 
-    const auto graphicsQueue = m_Device->get_graphics_queue();
-    vk_check(
-        graphicsQueue.submit2(1, &submitInfo, immFence),
-        "Failed to submit immediate upload commands"
+    // A shared queue family releases nothing, so the copies are only ordered before this frame by a plain dependency.
+    if (m_pendingImageAcquires.empty() && m_pendingBufferAcquires.empty())
+        cmd.memory_barrier(
+            vk::PipelineStageFlagBits2::eAllTransfer, vk::AccessFlagBits2::eTransferWrite,
+            vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead
         );
+    else
+        cmd.pipeline_barrier(m_pendingImageAcquires, m_pendingBufferAcquires);
+    m_graphicsWaitValue = std::max(m_graphicsWaitValue, m_pendingAcquireValue);
 
-    vk_check(
-        deviceHandle.waitForFences(1, &immFence, true, UINT64_MAX),
-        "Failed to wait for fences"
-        );
+    m_pendingImageAcquires.clear();
+    m_pendingBufferAcquires.clear();
+    m_pendingAcquireValue = 0;
 }
 
 bool Context::swapchain_need_recreation(const vk::Result result)
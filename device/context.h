@@ -6,6 +6,7 @@
 
 #include <fstream>
 #include <memory>
+#include <mutex>
 
 struct SceneData {
     glm::mat4 view;
@@ -15,11 +16,12 @@ struct SceneData {
 
 class Context {
 public:
-    explicit Context(std::string_view appName, u32 width, u32 height);
+    explicit Context(std::string_view appName, u32 width, u32 height, bool headless = false);
     ~Context();
 
     void frame_submit(const std::function<void(FrameInFlight& cmd, SwapchainImageData& swapchainData)>&& func);
     [[nodiscard]] FrameInFlight& get_fif() const { return m_Device->commandBufferInfos[frameNumber % MAX_FRAMES_IN_FLIGHT]; }
+    [[nodiscard]] u32 get_frame_index() const { return frameNumber % MAX_FRAMES_IN_FLIGHT; }
 
     [[nodiscard]] vk::Device get_device_handle() const { return m_Device->get_handle(); }
     [[nodiscard]] Device& get_device() const { return *m_Device; }
@@ -27,9 +29,12 @@ public:
     [[nodiscard]] vk::Queue get_graphic_queue() const { return m_Device->get_graphics_queue(); }
     [[nodiscard]] vk::Queue get_transfer_queue() const { return m_Device->get_transferQueue(); }
     [[nodiscard]] vk::Queue get_present_queue() const { return m_Device->get_present_queue(); }
+    [[nodiscard]] const QueueFamilyIndices& get_queue_families() const { return m_Device->get_queue_families(); }
     [[nodiscard]] GLFWwindow* p_get_window() const { return m_Device->get_window_p(); }
+    [[nodiscard]] bool is_headless() const { return m_Device->is_headless(); }
     [[nodiscard]] Image& get_draw_image() const { return m_Device->get_draw_image(); }
     [[nodiscard]] Image& get_depth_image() const { return m_Device->get_depth_image(); }
+    [[nodiscard]] DepthPyramid& get_depth_pyramid() const { return m_Device->get_depth_pyramid(); }
     [[nodiscard]] VkRenderingAttachmentInfo get_draw_attachment() const { return m_Device->get_draw_attachment(); }
     [[nodiscard]] VkRenderingAttachmentInfo get_depth_attachment() const { return m_Device->get_depth_attachment(); }
     [[nodiscard]] std::array<FrameInFlight, MAX_FRAMES_IN_FLIGHT>& get_command_buffer_infos() const { return m_Device->commandBufferInfos; }
@@ -52,21 +57,44 @@ public:
     [[nodiscard]] vk::Extent2D get_display_extent() const { return m_Device->get_display_extent(); }
 
     void init_imgui() const;
+    void init_worker_commands(const u32 workerCount) const { m_Device->init_worker_commands(workerCount); }
 
     void submit_work(
         const CommandBuffer& cmd,
         vk::PipelineStageFlagBits2 wait,
         vk::PipelineStageFlagBits2 signal,
         vk::Semaphore acquiredSemaphore, vk::Semaphore renderEndSemaphore,
-        vk::Fence renderFence) const;
-    void submit_upload_work() const;
-    void submit_immediate_work(std::function<void(CommandBuffer cmd)>&& function) const;
+        vk::Fence renderFence);
+
+    // Submits cmd to the transfer queue and returns the transfer timeline value it signals once complete.
+    u64 submit_transfer_work(const CommandBuffer& cmd);
+    void wait_for_transfer(u64 timelineValue) const;
+    // Queues the graphics side of ownership transfers released by a transfer submission. They are recorded by the next
+    // acquire_transfers(), whose frame then waits for timelineValue before executing.
+    void enqueue_acquire(
+        u64 timelineValue,
+        std::span<const vk::ImageMemoryBarrier2> imageBarriers,
+        std::span<const vk::BufferMemoryBarrier2> bufferBarriers);
+    void acquire_transfers(const CommandBuffer& cmd);
 
 private:
     bool swapchain_need_recreation(vk::Result result);
+    void headless_frame_submit(const std::function<void(FrameInFlight& cmd, SwapchainImageData& swapchainData)>& func);
 
     std::unique_ptr<Device> m_Device;
     u32 frameNumber = 0;
     u32 swapchainImageIndex = 0;
     vk::Extent2D previousSwapchainExtent;
+
+    // Uploads are submitted from loader threads and the transfer family may share the graphics queue, so every queue
+    // submission and present holds m_queueMutex.
+    std::mutex m_queueMutex;
+    u64 m_transferTimelineValue = 0;
+
+    std::mutex m_acquireMutex;
+    std::vector<vk::ImageMemoryBarrier2> m_pendingImageAcquires;
+    std::vector<vk::BufferMemoryBarrier2> m_pendingBufferAcquires;
+    u64 m_pendingAcquireValue = 0;
+    // Transfer timeline value the next graphics submission waits for, set by acquire_transfers().
+    u64 m_graphicsWaitValue = 0;
 };
@@ -1,19 +1,26 @@
 
 #include "device.h"
 
-Device::Device(std::string_view appName, const u32 _width, const u32 _height)
+Device::Device(std::string_view appName, const u32 _width, const u32 _height, const bool headless)
+    : m_Headless(headless), m_HeadlessExtent(_width, _height)
 {
-    init_window({_width, _height});
+    if (!m_Headless)
+        init_window({_width, _height});
     init_instance();
-    init_surface();
+    if (!m_Headless)
+        init_surface();
     select_gpu();
     init_device();
-    init_swapchain();
+    if (!m_Headless)
+        init_swapchain();
     init_allocator();
     init_commands();
     init_sync_objects();
+    init_query_pools();
     init_draw_images();
     init_depth_images();
+    init_depth_pyramid_sampler();
+    init_depth_pyramid();
 }
 
 Device::~Device()
@@ -21,11 +28,16 @@ Device::~Device()
     handle.waitIdle();
     for (auto& frame : commandBufferInfos) {
         handle.destroyCommandPool(frame.commandPool, nullptr);
+        for (const auto workerPool : frame.workerCommandPools)
+            handle.destroyCommandPool(workerPool, nullptr);
         handle.destroyFence(frame.renderFence, nullptr);
         handle.destroySemaphore(frame.acquiredSemaphore, nullptr);
+        handle.destroyQueryPool(frame.timestampQueryPool, nullptr);
     }
 
-    destroy_swapchain();
+    // Headless devices are created without VK_KHR_swapchain and never have one.
+    if (!m_Headless)
+        destroy_swapchain();
 
     vmaDestroyImage(allocator, m_DrawImage.handle, m_DrawImage.allocation);
     vkDestroyImageView(handle, m_DrawImage.view, nullptr);
@@ -33,8 +45,15 @@ Device::~Device()
     vmaDestroyImage(allocator, m_DepthImage.handle, m_DepthImage.allocation);
     vkDestroyImageView(handle, m_DepthImage.view, nullptr);
 
+    destroy_depth_pyramid();
+    handle.destroySampler(m_DepthPyramid.sampler, nullptr);
+
     handle.destroyCommandPool(immediateInfo.immediateCommandPool, nullptr);
     handle.destroyFence(immediateInfo.immediateFence, nullptr);
+    handle.destroySemaphore(m_TransferTimeline, nullptr);
+
+    if (m_Headless)
+        return;
 
     instance.destroySurfaceKHR(m_Surface, nullptr);
 
@@ -43,6 +62,9 @@ Device::~Device()
 
 vk::Extent2D Device::get_display_extent()
 {
+    if (m_Headless)
+        return m_HeadlessExtent;
+
     u32 width {}, height {};
     glfwGetFramebufferSize(m_Window, reinterpret_cast<int*>(&width), reinterpret_cast<int*>(&height));
     m_DrawImage.extent = {width, height};
@@ -79,8 +101,10 @@ void Device::recreate_draw_images()
 {
     destroy_draw_images();
     destroy_depth_images();
+    destroy_depth_pyramid();
     init_draw_images();
     init_depth_images();
+    init_depth_pyramid();
 }
 
 void Device::init_window(const vk::Extent2D extent)
@@ -166,9 +190,17 @@ void Device::select_gpu()
 void Device::init_device()
 {
     QueueFamilyIndices indices = find_queue_families(m_Gpu);
+    m_QueueFamilies = indices;
+    m_MeshShading = check_mesh_shader_support(m_Gpu);
+    m_MaxComputeGroupCountX = m_Gpu.getProperties().limits.maxComputeWorkGroupCount[0];
 
     std::vector<vk::DeviceQueueCreateInfo> queueCIs;
-    std::set uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    std::set uniqueQueueFamilies = {
+        indices.graphicsFamily.value(),
+        indices.presentFamily.value(),
+        indices.computeFamily.value(),
+        indices.transferFamily.value()
+    };
 
     f32 queuePriority = 1.0f;
     for (u32 queueFamily : uniqueQueueFamilies) {
@@ -199,8 +231,11 @@ void Device::init_device()
     deviceVulkan12Features.descriptorBindingUniformBufferUpdateAfterBind = true;
     deviceVulkan12Features.descriptorBindingVariableDescriptorCount = true;
     deviceVulkan12Features.scalarBlockLayout = true;
+    deviceVulkan12Features.drawIndirectCount = true;
+    deviceVulkan12Features.samplerFilterMinmax = true;
     deviceVulkan12Features.vulkanMemoryModel = true;
     deviceVulkan12Features.vulkanMemoryModelDeviceScope = true;
+    deviceVulkan12Features.timelineSemaphore = true;
     deviceVulkan11Features.pNext = deviceVulkan12Features;
 
     vk::PhysicalDeviceVulkan13Features deviceVulkan13Features;
@@ -215,12 +250,20 @@ void Device::init_device()
     robustnessFeaturesEXT.robustBufferAccess2 = true;
     deviceVulkan14Features.pNext = &robustnessFeaturesEXT;
 
+    // Optional, the vertex pipeline is used without it.
+    vk::PhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures;
+    meshShaderFeatures.taskShader = true;
+    meshShaderFeatures.meshShader = true;
+    if (m_MeshShading)
+        robustnessFeaturesEXT.pNext = &meshShaderFeatures;
+
     vk::DeviceCreateInfo deviceCI;
     deviceCI.pNext = &deviceFeatures;
     deviceCI.queueCreateInfoCount = static_cast<u32>(queueCIs.size());
     deviceCI.pQueueCreateInfos = queueCIs.data();
-    deviceCI.enabledExtensionCount = static_cast<u32>(deviceExtensions.size());
-    deviceCI.ppEnabledExtensionNames = deviceExtensions.data();
+    const auto extensions = get_device_extensions();
+    deviceCI.enabledExtensionCount = static_cast<u32>(extensions.size());
+    deviceCI.ppEnabledExtensionNames = extensions.data();
 
     handle = m_Gpu.createDevice(deviceCI, nullptr);
 
@@ -228,6 +271,9 @@ void Device::init_device()
     computeQueue = handle.getQueue(indices.computeFamily.value(), computeQueueIndex);
     presentQueue = handle.getQueue(indices.presentFamily.value(), presentQueueIndex);
     transferQueue = handle.getQueue(indices.transferFamily.value(), transferQueueIndex);
+
+    if (m_MeshShading)
+        CommandBuffer::load_mesh_shader_functions(handle);
 }
 
 void Device::init_swapchain()
@@ -337,11 +383,44 @@ void Device::init_swapchain()
     }
 }
 
+void Device::init_worker_commands(const u32 workerCount)
+{
+    vk::CommandPoolCreateInfo commandPoolCI;
+    commandPoolCI.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    commandPoolCI.queueFamilyIndex = m_QueueFamilies.graphicsFamily.value();
+
+    for (auto& frame : commandBufferInfos) {
+        frame.workerCommandPools.resize(workerCount);
+        frame.workerCommandBuffers.resize(workerCount);
+
+        for (u32 i = 0; i < workerCount; i++) {
+            vk_check(
+                handle.createCommandPool(&commandPoolCI, nullptr, &frame.workerCommandPools[i]),
+                "Failed to create worker command pool"
+            );
+
+            vk::CommandBufferAllocateInfo allocInfo;
+            allocInfo.commandPool = frame.workerCommandPools[i];
+            allocInfo.commandBufferCount = 1;
+            allocInfo.level = vk::CommandBufferLevel::eSecondary;
+
+            vk::CommandBuffer newCmd;
+            vk_check(
+                handle.allocateCommandBuffers(&allocInfo, &newCmd),
+                "Failed to allocate worker command buffers"
+            );
+
+            frame.workerCommandBuffers[i].set_handle(newCmd);
+            frame.workerCommandBuffers[i].set_allocator(allocator);
+        }
+    }
+}
+
 void Device::init_commands()
 {
     vk::CommandPoolCreateInfo commandPoolCI;
     commandPoolCI.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
-    commandPoolCI.queueFamilyIndex = graphicsQueueIndex;
+    commandPoolCI.queueFamilyIndex = m_QueueFamilies.graphicsFamily.value();
 
     for (i32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vk_check(
@@ -400,6 +479,30 @@ void Device::init_sync_objects()
         handle.createFence(&fenceCI, nullptr, &immediateInfo.immediateFence),
         "Failed to create immediate fence"
     );
+
+    vk::SemaphoreTypeCreateInfo timelineCI(vk::SemaphoreType::eTimeline, 0);
+    vk::SemaphoreCreateInfo timelineSemaphoreCI;
+    timelineSemaphoreCI.pNext = &timelineCI;
+    vk_check(
+        handle.createSemaphore(&timelineSemaphoreCI, nullptr, &m_TransferTimeline),
+        "Failed to create transfer timeline semaphore"
+    );
+}
+
+void Device::init_query_pools()
+{
+    m_TimestampPeriod = m_Gpu.getProperties().limits.timestampPeriod;
+    m_TimestampValidBits = m_Gpu.getQueueFamilyProperties()[m_QueueFamilies.graphicsFamily.value()].timestampValidBits;
+
+    vk::QueryPoolCreateInfo queryPoolCI;
+    queryPoolCI.queryType = vk::QueryType::eTimestamp;
+    queryPoolCI.queryCount = MAX_TIMESTAMP_QUERIES;
+
+    for (auto& frame : commandBufferInfos)
+        vk_check(
+            handle.createQueryPool(&queryPoolCI, nullptr, &frame.timestampQueryPool),
+            "Failed to create timestamp query pool"
+        );
 }
 
 void Device::init_allocator()
@@ -478,7 +581,7 @@ void Device::init_depth_images()
     m_DepthImage.format = VK_FORMAT_D32_SFLOAT;
     m_DepthImage.extent = depthImageExtent;
 
-    constexpr VkImageUsageFlags depthImageUsages = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    constexpr VkImageUsageFlags depthImageUsages = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
     VkImageCreateInfo imageCI{.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, .pNext = nullptr};
     imageCI.format = m_DepthImage.format;
@@ -514,10 +617,82 @@ void Device::init_depth_images()
     depthAttachment.imageView = m_DepthImage.view;
     depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     depthAttachment.clearValue.depthStencil.depth = 0.f;
 }
 
+void Device::init_depth_pyramid()
+{
+    const auto [width, height] = get_display_extent();
+    const u32 pyramidWidth = std::bit_floor(std::max(width, 1u));
+    const u32 pyramidHeight = std::bit_floor(std::max(height, 1u));
+    const u32 mipLevels = std::bit_width(std::max(pyramidWidth, pyramidHeight));
+
+    auto& pyramidImage = m_DepthPyramid.image;
+    pyramidImage.format = VK_FORMAT_R32_SFLOAT;
+    pyramidImage.extent = {pyramidWidth, pyramidHeight, 1};
+    pyramidImage.mipLevels = mipLevels;
+
+    VkImageCreateInfo imageCI{.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, .pNext = nullptr};
+    imageCI.format = pyramidImage.format;
+    imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageCI.extent = pyramidImage.extent;
+    imageCI.imageType = VK_IMAGE_TYPE_2D;
+    imageCI.mipLevels = mipLevels;
+    imageCI.arrayLayers = 1;
+    imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+
+    VmaAllocationCreateInfo allocationCI{};
+    allocationCI.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocationCI.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    vmaCreateImage(allocator, &imageCI, &allocationCI, &pyramidImage.handle, &pyramidImage.allocation, nullptr);
+
+    VkImageViewCreateInfo imageViewCI{.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, .pNext = nullptr};
+    imageViewCI.image = pyramidImage.handle;
+    imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageViewCI.format = pyramidImage.format;
+    imageViewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageViewCI.subresourceRange.baseMipLevel = 0;
+    imageViewCI.subresourceRange.levelCount = mipLevels;
+    imageViewCI.subresourceRange.baseArrayLayer = 0;
+    imageViewCI.subresourceRange.layerCount = 1;
+
+    vkCreateImageView(handle, &imageViewCI, nullptr, &pyramidImage.view);
+
+    m_DepthPyramid.mipViews.resize(mipLevels);
+    for (u32 i = 0; i < mipLevels; i++) {
+        imageViewCI.subresourceRange.baseMipLevel = i;
+        imageViewCI.subresourceRange.levelCount = 1;
+        vkCreateImageView(handle, &imageViewCI, nullptr, &m_DepthPyramid.mipViews[i]);
+    }
+}
+
+void Device::init_depth_pyramid_sampler()
+{
+    // Reverse-Z keeps the farthest depth as the smallest value, so a min reduction returns the most conservative
+    // occluder depth under the sampled footprint.
+    vk::SamplerReductionModeCreateInfo reductionCI;
+    reductionCI.reductionMode = vk::SamplerReductionMode::eMin;
+
+    vk::SamplerCreateInfo samplerCI;
+    samplerCI.pNext = &reductionCI;
+    samplerCI.magFilter = vk::Filter::eLinear;
+    samplerCI.minFilter = vk::Filter::eLinear;
+    samplerCI.mipmapMode = vk::SamplerMipmapMode::eNearest;
+    samplerCI.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+    samplerCI.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+    samplerCI.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+    samplerCI.minLod = 0.0f;
+    samplerCI.maxLod = vk::LodClampNone;
+
+    vk_check(
+        handle.createSampler(&samplerCI, nullptr, &m_DepthPyramid.sampler),
+        "Failed to create depth pyramid sampler"
+    );
+}
+
 void Device::init_imgui() const {
         const vk::DescriptorPoolSize poolSizes[] = {
             { vk::DescriptorType::eSampler, 1000 },
@@ -575,23 +750,52 @@ void Device::init_imgui() const {
 
 std::vector<const char*> Device::get_required_extensions()
 {
-    u32 glfwExtensionCount = 0;
-    const char **glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    std::vector extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char*> extensions;
+    if (!m_Headless) {
+        u32 glfwExtensionCount = 0;
+        const char **glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
     if (enableValidationLayers) extensions.push_back(vk::EXTDebugUtilsExtensionName);
 
     return extensions;
 }
 
+std::vector<const char*> Device::get_device_extensions() const
+{
+    std::vector extensions(deviceExtensions.begin(), deviceExtensions.end());
+    if (m_MeshShading)
+        extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    if (m_Headless)
+        std::erase_if(extensions, [](const char* extension) {
+            return std::string_view(extension) == VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+        });
+
+    return extensions;
+}
+
+bool Device::check_mesh_shader_support(const vk::PhysicalDevice gpu) const
+{
+    const auto availableExtensions = gpu.enumerateDeviceExtensionProperties();
+    const bool extensionSupported = std::ranges::any_of(availableExtensions, [](const vk::ExtensionProperties& extension) {
+        return std::string_view(extension.extensionName) == VK_EXT_MESH_SHADER_EXTENSION_NAME;
+    });
+    if (!extensionSupported)
+        return false;
+
+    const auto features = gpu.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+    const auto& meshShaderFeatures = features.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+    return meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+}
+
 bool Device::gpu_is_suitable(const vk::PhysicalDevice gpu)
 {
     const QueueFamilyIndices indices = find_queue_families(gpu);
 
     const bool extensionsSupported = check_device_extension_support(gpu);
 
-    bool swapchainAdequate = false;
-    if (extensionsSupported) {
+    bool swapchainAdequate = m_Headless;
+    if (extensionsSupported && !m_Headless) {
         SwapChainSupportDetails swapchainSupport = query_swapchain_support(gpu);
         swapchainAdequate = !swapchainSupport.formats.empty() && !swapchainSupport.presentModes.empty();
     }
@@ -608,23 +812,33 @@ QueueFamilyIndices Device::find_queue_families(const vk::PhysicalDevice gpu) con
     std::vector<vk::QueueFamilyProperties> families(count);
     gpu.getQueueFamilyProperties(&count, families.data());
 
+    // The first graphics family also does compute and transfer. A transfer only family is preferred for uploads since
+    // it maps to the copy engines and runs beside rendering, otherwise uploads fall back to the graphics family.
     i32 idx = 0;
     for (const auto& family : families) {
-        if (family.queueFlags & vk::QueueFlagBits::eGraphics) indices.graphicsFamily = idx;
-        if (family.queueFlags & vk::QueueFlagBits::eCompute) indices.computeFamily = idx;
-        if (family.queueFlags & vk::QueueFlagBits::eTransfer) indices.transferFamily = idx;
-
-        vk::Bool32 presentSupport = false;
-        vk_check(
-            gpu.getSurfaceSupportKHR(idx, m_Surface, &presentSupport),
-            "Failed to get GPU present support"
-            );
-
-        if (presentSupport) indices.presentFamily = idx;
-        if (indices.is_complete()) break;
+        const bool graphics = static_cast<bool>(family.queueFlags & vk::QueueFlagBits::eGraphics);
+        const bool compute = static_cast<bool>(family.queueFlags & vk::QueueFlagBits::eCompute);
+        const bool transfer = static_cast<bool>(family.queueFlags & vk::QueueFlagBits::eTransfer);
+
+        if (graphics && !indices.graphicsFamily) indices.graphicsFamily = idx;
+        if (compute && !indices.computeFamily) indices.computeFamily = idx;
+        if (transfer && !graphics && !compute && !indices.transferFamily) indices.transferFamily = idx;
+
+        // Nothing is presented without a surface, so the graphics family stands in for the present family.
+        vk::Bool32 presentSupport = m_Headless && graphics;
+        if (!m_Headless)
+            vk_check(
+                gpu.getSurfaceSupportKHR(idx, m_Surface, &presentSupport),
+                "Failed to get GPU present support"
+                );
+
+        if (presentSupport && !indices.presentFamily) indices.presentFamily = idx;
         idx++;
     }
 
+    if (!indices.transferFamily)
+        indices.transferFamily = indices.graphicsFamily;
+
     return indices;
 }
 
@@ -642,7 +856,8 @@ bool Device::check_device_extension_support(vk::PhysicalDevice gpu)
         "Failed to enumer device extension properties"
         );
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    const auto enabledExtensions = get_device_extensions();
+    std::set<std::string> requiredExtensions(enabledExtensions.begin(), enabledExtensions.end());
 
     std::println("Required extensions");
     for (const auto& extension : requiredExtensions)
@@ -753,3 +968,12 @@ void Device::destroy_depth_images() const
     vmaDestroyImage(allocator, m_DepthImage.handle, m_DepthImage.allocation);
     vkDestroyImageView(handle, m_DepthImage.view, nullptr);
 }
+
+void Device::destroy_depth_pyramid() const
+{
+    for (const auto mipView : m_DepthPyramid.mipViews)
+        vkDestroyImageView(handle, mipView, nullptr);
+
+    vkDestroyImageView(handle, m_DepthPyramid.image.view, nullptr);
+    vmaDestroyImage(allocator, m_DepthPyramid.image.handle, m_DepthPyramid.image.allocation);
+}
@@ -11,10 +11,12 @@
 #include <limits>
 
 #include <functional>
+#include <bit>
 
 #include <set>
 
 static constexpr u8 MAX_FRAMES_IN_FLIGHT = 2;
+static constexpr u32 MAX_TIMESTAMP_QUERIES = 64;
 
 #ifdef NDEBUG
     static constexpr bool enableValidationLayers = false;
@@ -63,6 +65,19 @@ struct FrameInFlight
     vk::Semaphore acquiredSemaphore;
     vk::Fence renderFence;
     bool resizeRequested = false;
+
+    // Timestamp queries for the GpuProfiler scopes recorded this frame.
+    vk::QueryPool timestampQueryPool;
+
+    // One pool per job system worker so secondary command buffers can be recorded concurrently.
+    std::vector<vk::CommandPool> workerCommandPools;
+    std::vector<CommandBuffer> workerCommandBuffers;
+};
+
+struct DepthPyramid {
+    Image image{};
+    std::vector<VkImageView> mipViews;
+    vk::Sampler sampler;
 };
 
 struct ImmediateCommandInfo {
@@ -73,7 +88,7 @@ struct ImmediateCommandInfo {
 
 class Device {
 public:
-    Device(std::string_view appName, u32 _width, u32 _height);
+    Device(std::string_view appName, u32 _width, u32 _height, bool headless = false);
     ~Device();
 public:
     std::vector<SwapchainImageData> swapchainImageData;
@@ -83,19 +98,31 @@ public:
     [[nodiscard]] vk::Queue get_graphics_queue() const { return graphicsQueue; }
     [[nodiscard]] vk::Queue get_present_queue() const { return presentQueue; }
     [[nodiscard]] vk::Queue get_transferQueue() const { return transferQueue; }
+    [[nodiscard]] const QueueFamilyIndices& get_queue_families() const { return m_QueueFamilies; }
     [[nodiscard]] VmaAllocator get_allocator() const { return allocator; }
     [[nodiscard]] Image& get_draw_image() { return m_DrawImage; }
     [[nodiscard]] Image& get_depth_image() { return m_DepthImage; }
+    [[nodiscard]] DepthPyramid& get_depth_pyramid() { return m_DepthPyramid; }
     [[nodiscard]] vk::Extent2D get_display_extent();
     [[nodiscard]] vk::SwapchainKHR get_swapchain() const { return m_Swapchain; }
     [[nodiscard]] GLFWwindow* get_window_p() const { return m_Window; }
+    [[nodiscard]] bool is_headless() const { return m_Headless; }
+    [[nodiscard]] f32 get_timestamp_period() const { return m_TimestampPeriod; }
+    // Of the graphics queue, 0 when it does not support timestamps.
+    [[nodiscard]] u32 get_timestamp_valid_bits() const { return m_TimestampValidBits; }
+    // EXT_mesh_shader with task shaders, enabled whenever the GPU has it.
+    [[nodiscard]] bool supports_mesh_shading() const { return m_MeshShading; }
+    // Upper bound of a dispatch's x group count, at least 65535.
+    [[nodiscard]] u32 get_max_compute_group_count_x() const { return m_MaxComputeGroupCountX; }
     [[nodiscard]] ImmediateCommandInfo get_immediate_info() const { return immediateInfo; }
+    [[nodiscard]] vk::Semaphore get_transfer_timeline() const { return m_TransferTimeline; }
     [[nodiscard]] VkRenderingAttachmentInfo get_draw_attachment() const { return drawAttachment; }
     [[nodiscard]] VkRenderingAttachmentInfo get_depth_attachment() const { return depthAttachment; }
 
     bool recreate_swapchain();
     void recreate_draw_images();
     void init_imgui() const;
+    void init_worker_commands(u32 workerCount);
 
 private:
     void init_window(vk::Extent2D extent);
@@ -106,15 +133,20 @@ private:
     void init_swapchain();
     void init_commands();
     void init_sync_objects();
+    void init_query_pools();
     void init_allocator();
     void init_draw_images();
     void init_depth_images();
+    void init_depth_pyramid();
+    void init_depth_pyramid_sampler();
 
 private:
     std::vector<const char*> get_required_extensions();
+    [[nodiscard]] std::vector<const char*> get_device_extensions() const;
     bool gpu_is_suitable(vk::PhysicalDevice gpu);
     [[nodiscard]] QueueFamilyIndices find_queue_families(vk::PhysicalDevice gpu) const;
     bool check_device_extension_support(vk::PhysicalDevice gpu);
+    [[nodiscard]] bool check_mesh_shader_support(vk::PhysicalDevice gpu) const;
     SwapChainSupportDetails query_swapchain_support(vk::PhysicalDevice gpu);
     vk::SurfaceFormatKHR choose_swap_surface_format(const std::vector<vk::SurfaceFormatKHR>& availableFormats);
     vk::PresentModeKHR choose_swap_present_mode(const std::vector<vk::PresentModeKHR>& availablePresentModes);
@@ -123,13 +155,21 @@ private:
     void destroy_swapchain();
     void destroy_draw_images() const;
     void destroy_depth_images() const;
+    void destroy_depth_pyramid() const;
 
 private:
     std::string applicationName;
+    // Headless devices have no window, surface or swapchain and render into m_DrawImage only.
+    bool m_Headless = false;
+    vk::Extent2D m_HeadlessExtent;
     std::vector<const char*> validationLayers {"VK_LAYER_KHRONOS_validation"};
     vk::Instance instance;
     vk::Device handle;
     vk::PhysicalDevice m_Gpu;
+    f32 m_TimestampPeriod{};
+    u32 m_TimestampValidBits{};
+    bool m_MeshShading = false;
+    u32 m_MaxComputeGroupCountX{};
 
     GLFWwindow* m_Window = nullptr;
     vk::SurfaceKHR m_Surface;
@@ -139,13 +179,17 @@ private:
 
     Image m_DrawImage;
     Image m_DepthImage;
+    DepthPyramid m_DepthPyramid;
     VkRenderingAttachmentInfo drawAttachment;
     VkRenderingAttachmentInfo depthAttachment;
 
+    QueueFamilyIndices m_QueueFamilies;
     u32 graphicsQueueIndex{}, computeQueueIndex{}, presentQueueIndex{}, transferQueueIndex{};
     vk::Queue graphicsQueue, computeQueue, presentQueue, transferQueue;
 
     ImmediateCommandInfo immediateInfo;
+    // Signalled by every transfer queue submission with an increasing value, see Context::submit_transfer_work().
+    vk::Semaphore m_TransferTimeline;
 
     VmaAllocator allocator{};
 };
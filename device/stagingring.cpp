@@ -0,0 +1,165 @@
+#include "stagingring.h"
+
+StagingRing::StagingRing(Context& context, const u64 size)
+    : m_context(context), m_segmentSize(size / STAGING_RING_SEGMENTS)
+{
+    const auto deviceHandle = m_context.get_device_handle();
+    m_buffer = m_context.create_staging_buffer(size);
+
+    const auto& queueFamilies = m_context.get_queue_families();
+    m_transferFamily = queueFamilies.transferFamily.value();
+    m_graphicsFamily = queueFamilies.graphicsFamily.value();
+
+    vk::CommandPoolCreateInfo commandPoolCI;
+    commandPoolCI.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    commandPoolCI.queueFamilyIndex = m_transferFamily;
+
+    for (u32 i = 0; i < STAGING_RING_SEGMENTS; i++) {
+        auto& segment = m_segments[i];
+        segment.offset = i * m_segmentSize;
+
+        vk_check(
+            deviceHandle.createCommandPool(&commandPoolCI, nullptr, &segment.commandPool),
+            "Failed to create staging command pool"
+        );
+
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo.commandPool = segment.commandPool;
+        allocInfo.commandBufferCount = 1;
+        allocInfo.level = vk::CommandBufferLevel::ePrimary;
+
+        vk::CommandBuffer newCmd;
+        vk_check(
+            deviceHandle.allocateCommandBuffers(&allocInfo, &newCmd),
+            "Failed to allocate staging command buffer"
+        );
+        segment.commandBuffer.set_handle(newCmd);
+        segment.commandBuffer.set_allocator(m_context.get_allocator());
+    }
+}
+
+StagingRing::~StagingRing()
+{
+    const auto deviceHandle = m_context.get_device_handle();
+    wait_idle();
+
+    for (const auto& segment : m_segments)
+        deviceHandle.destroyCommandPool(segment.commandPool, nullptr);
+
+    vmaDestroyBuffer(m_context.get_allocator(), m_buffer.handle, m_buffer.allocation);
+}
+
+CommandBuffer& StagingRing::begin_segment()
+{
+    m_currentSegment = (m_currentSegment + 1) % STAGING_RING_SEGMENTS;
+    auto& segment = m_segments[m_currentSegment];
+
+    m_context.wait_for_transfer(segment.timelineValue);
+    segment.imageAcquires.clear();
+    segment.bufferAcquires.clear();
+
+    segment.commandBuffer.begin();
+    return segment.commandBuffer;
+}
+
+void StagingRing::submit_segment()
+{
+    auto& segment = m_segments[m_currentSegment];
+    segment.commandBuffer.end();
+
+    // Enqueued even without barriers so the next frame still waits for the copies when no ownership transfer is needed.
+    segment.timelineValue = m_context.submit_transfer_work(segment.commandBuffer);
+    m_context.enqueue_acquire(segment.timelineValue, segment.imageAcquires, segment.bufferAcquires);
+}
+
+void StagingRing::wait_idle() const
+{
+    u64 timelineValue = 0;
+    for (const auto& segment : m_segments)
+        timelineValue = std::max(timelineValue, segment.timelineValue);
+
+    m_context.wait_for_transfer(timelineValue);
+}
+
+void StagingRing::upload_buffer(const Buffer& dst, const void* data, const u64 size)
+{
+    const auto bytes = static_cast<const u8*>(data);
+    upload_buffer(dst, size, [bytes](const u64 offset, const u64 chunkSize, u8* destination) {
+        memcpy(destination, bytes + offset, chunkSize);
+    });
+}
+
+void StagingRing::upload_buffer(const Buffer& dst, const u64 size, const StagingWrite& write)
+{
+    u64 uploaded = 0;
+    do {
+        const u64 chunkSize = std::min(size - uploaded, m_segmentSize);
+        const auto& cmd = begin_segment();
+
+        if (chunkSize > 0) {
+            // The segment is still submitted when write fails, so the ring never hands out a recording command buffer.
+            try {
+                write(uploaded, chunkSize, get_segment_data());
+            }
+            catch (...) {
+                submit_segment();
+                throw;
+            }
+            cmd.copy_buffer(m_buffer, dst, get_segment_offset(), uploaded, chunkSize);
+        }
+        uploaded += chunkSize;
+
+        if (uploaded == size)
+            release_buffer(dst);
+        submit_segment();
+    } while (uploaded < size);
+}
+
+void StagingRing::release_image(const Image& image)
+{
+    auto& segment = m_segments[m_currentSegment];
+    if (m_transferFamily == m_graphicsFamily) {
+        segment.commandBuffer.image_barrier(image.handle, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+        return;
+    }
+
+    // The release and acquire must describe the same layout transition, it executes once between the two queues.
+    vk::ImageMemoryBarrier2 release(
+        vk::PipelineStageFlagBits2::eAllTransfer, vk::AccessFlagBits2::eTransferWrite,
+        vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+        vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+        m_transferFamily, m_graphicsFamily,
+        image.handle,
+        vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, vk::RemainingMipLevels, 0, vk::RemainingArrayLayers)
+        );
+    segment.commandBuffer.pipeline_barrier({&release, 1}, {});
+
+    vk::ImageMemoryBarrier2 acquire = release;
+    acquire.srcStageMask = vk::PipelineStageFlagBits2::eNone;
+    acquire.srcAccessMask = vk::AccessFlagBits2::eNone;
+    acquire.dstStageMask = vk::PipelineStageFlagBits2::eAllCommands;
+    acquire.dstAccessMask = vk::AccessFlagBits2::eShaderRead;
+    segment.imageAcquires.push_back(acquire);
+}
+
+void StagingRing::release_buffer(const Buffer& buffer)
+{
+    auto& segment = m_segments[m_currentSegment];
+    if (m_transferFamily == m_graphicsFamily)
+        return;
+
+    vk::BufferMemoryBarrier2 release(
+        vk::PipelineStageFlagBits2::eAllTransfer, vk::AccessFlagBits2::eTransferWrite,
+        vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+        m_transferFamily, m_graphicsFamily,
+        buffer.handle, 0, vk::WholeSize
+        );
+    segment.commandBuffer.pipeline_barrier({}, {&release, 1});
+
+    vk::BufferMemoryBarrier2 acquire = release;
+    acquire.srcStageMask = vk::PipelineStageFlagBits2::eNone;
+    acquire.srcAccessMask = vk::AccessFlagBits2::eNone;
+    acquire.dstStageMask = vk::PipelineStageFlagBits2::eAllCommands;
+    acquire.dstAccessMask = vk::AccessFlagBits2::eMemoryRead;
+    segment.bufferAcquires.push_back(acquire);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "context.h"
+
+#include <functional>
+
+static constexpr u64 STAGING_RING_SIZE = 128ull << 20;
+static constexpr u32 STAGING_RING_SEGMENTS = 2;
+
+// Writes size bytes of a source, starting at offset, into mapped staging memory at destination.
+using StagingWrite = std::function<void(u64 offset, u64 size, u8* destination)>;
+
+struct StagingSegment {
+    u64 offset{};
+    vk::CommandPool commandPool;
+    CommandBuffer commandBuffer{};
+    // Transfer timeline value signalled when the segment's last submission completed, 0 if never submitted.
+    u64 timelineValue{};
+    std::vector<vk::ImageMemoryBarrier2> imageAcquires;
+    std::vector<vk::BufferMemoryBarrier2> bufferAcquires;
+};
+
+// Fixed size, persistently mapped upload buffer split into segments that are filled and submitted in turn on the
+// transfer queue. A segment is only handed out again once the transfer timeline has reached its previous submission,
+// so memory stays bounded no matter how much is uploaded, and the CPU can fill one segment while the copy engine drains
+// the other. Resources written by a segment are released to the graphics family and acquired by the next frame.
+class StagingRing {
+public:
+    explicit StagingRing(Context& context, u64 size = STAGING_RING_SIZE);
+    ~StagingRing();
+
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    // Waits for the next segment's previous copies and begins its command buffer.
+    CommandBuffer& begin_segment();
+    // Submits the segment to the transfer queue and hands its acquire barriers to the context.
+    void submit_segment();
+    void wait_idle() const;
+
+    // Copies data into dst through as many segments as needed, then releases dst to the graphics queue.
+    void upload_buffer(const Buffer& dst, const void* data, u64 size);
+    // As above, with write filling each segment's part of the size bytes; every part but the last is a whole segment.
+    void upload_buffer(const Buffer& dst, u64 size, const StagingWrite& write);
+    // Transitions an image written by the current segment from TransferDst to ShaderReadOnly, transferring ownership to
+    // the graphics family when the transfer queue belongs to a different family.
+    void release_image(const Image& image);
+    void release_buffer(const Buffer& buffer);
+
+    [[nodiscard]] const Buffer& get_buffer() const { return m_buffer; }
+    [[nodiscard]] u64 get_segment_size() const { return m_segmentSize; }
+    [[nodiscard]] u64 get_segment_offset() const { return m_segments[m_currentSegment].offset; }
+    [[nodiscard]] u8* get_segment_data() const {
+        return static_cast<u8*>(m_buffer.p_get_mapped_data()) + get_segment_offset();
+    }
+
+private:
+    Context& m_context;
+    Buffer m_buffer{};
+    u64 m_segmentSize{};
+    std::array<StagingSegment, STAGING_RING_SEGMENTS> m_segments{};
+    u32 m_currentSegment = STAGING_RING_SEGMENTS - 1;
+    u32 m_transferFamily{};
+    u32 m_graphicsFamily{};
+};
@@ -0,0 +1,131 @@
+#include "jobsystem.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(const u32 threadCount) : m_ownerThread(std::this_thread::get_id()) {
+    m_queues.resize(threadCount + 1);
+    for (auto& queue : m_queues)
+        queue = std::make_unique<WorkQueue>();
+
+    m_threads.reserve(threadCount);
+    for (u32 i = 1; i <= threadCount; i++)
+        m_threads.emplace_back([this, i](const std::stop_token& stopToken) { worker_loop(stopToken, i); });
+}
+
+JobSystem::~JobSystem() {
+    wait();
+    for (auto& thread : m_threads)
+        thread.request_stop();
+    m_wakeCondition.notify_all();
+}
+
+void JobSystem::submit(Job job) {
+    submit(std::move(job), nullptr);
+}
+
+void JobSystem::submit(Job job, const std::latch* batch) {
+    m_pendingJobs.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard lock(m_wakeMutex);
+        m_queuedJobs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const u32 queueIndex = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % get_worker_count();
+    {
+        auto& queue = *m_queues[queueIndex];
+        std::lock_guard lock(queue.mutex);
+        queue.jobs.push_back({std::move(job), batch});
+    }
+
+    m_wakeCondition.notify_one();
+}
+
+void JobSystem::wait() {
+    while (m_pendingJobs.load(std::memory_order_acquire) > 0)
+        if (!run_next_job(0))
+            std::this_thread::yield();
+}
+
+void JobSystem::parallel_for(const u32 count, const std::function<void(u32 index, u32 workerIndex)>& function) {
+    const bool owner = std::this_thread::get_id() == m_ownerThread;
+
+    // Without worker threads nobody else would pick the jobs up, so other threads run them inline instead.
+    if (!owner && m_threads.empty()) {
+        for (u32 i = 0; i < count; i++)
+            function(i, 0);
+        return;
+    }
+
+    std::latch remaining(count);
+    for (u32 i = 0; i < count; i++)
+        submit([&function, &remaining, i](const u32 workerIndex) {
+            function(i, workerIndex);
+            remaining.count_down();
+        }, &remaining);
+
+    if (!owner) {
+        remaining.wait();
+        return;
+    }
+
+    while (!remaining.try_wait())
+        if (!run_next_job(0, &remaining))
+            std::this_thread::yield();
+}
+
+bool JobSystem::run_next_job(const u32 workerIndex, const std::latch* batch) {
+    const u32 queueCount = get_worker_count();
+    Job job;
+
+    for (u32 i = 0; i < queueCount && !job; i++) {
+        auto& queue = *m_queues[(workerIndex + i) % queueCount];
+        std::lock_guard lock(queue.mutex);
+        if (queue.jobs.empty())
+            continue;
+
+        if (batch) {
+            // Newest first from the own queue, oldest first from the others, skipping every other batch.
+            const auto matches = [batch](const QueuedJob& queued) { return queued.batch == batch; };
+            if (i == 0) {
+                const auto it = std::find_if(queue.jobs.rbegin(), queue.jobs.rend(), matches);
+                if (it == queue.jobs.rend())
+                    continue;
+                job = std::move(it->job);
+                queue.jobs.erase(std::next(it).base());
+            }
+            else {
+                const auto it = std::find_if(queue.jobs.begin(), queue.jobs.end(), matches);
+                if (it == queue.jobs.end())
+                    continue;
+                job = std::move(it->job);
+                queue.jobs.erase(it);
+            }
+        }
+        else if (i == 0) {
+            job = std::move(queue.jobs.back().job);
+            queue.jobs.pop_back();
+        }
+        else {
+            job = std::move(queue.jobs.front().job);
+            queue.jobs.pop_front();
+        }
+    }
+
+    if (!job)
+        return false;
+
+    m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    job(workerIndex);
+    m_pendingJobs.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::worker_loop(const std::stop_token& stopToken, const u32 workerIndex) {
+    while (!stopToken.stop_requested()) {
+        if (run_next_job(workerIndex))
+            continue;
+
+        std::unique_lock lock(m_wakeMutex);
+        m_wakeCondition.wait(lock, stopToken, [this] { return m_queuedJobs.load(std::memory_order_relaxed) > 0; });
+    }
+}
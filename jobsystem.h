@@ -0,0 +1,63 @@
+#pragma once
+#include "common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <latch>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing thread pool. Every worker owns a queue, pops its own jobs newest first and steals the oldest job
+// from the other queues when it runs dry. The thread that created the pool takes part as worker 0 while it waits, so
+// jobs always receive a worker index in [0, get_worker_count()) that can be used to pick per-thread resources.
+// Other threads, such as the scene loader, may call parallel_for() too; they only wait for their own jobs and never
+// run jobs themselves, which keeps worker indices unique. Jobs are tagged with the parallel_for() batch they belong
+// to, and while the owner waits on a batch it only helps with that batch's jobs, so it never picks up another
+// thread's long running jobs in the middle of a frame.
+class JobSystem {
+public:
+    using Job = std::function<void(u32 workerIndex)>;
+
+    explicit JobSystem(u32 threadCount = std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void submit(Job job);
+    // Waits for every submitted job. Only called by the thread that created the pool.
+    void wait();
+    // Returns once all count invocations have run, without waiting on jobs submitted by other threads.
+    void parallel_for(u32 count, const std::function<void(u32 index, u32 workerIndex)>& function);
+
+    [[nodiscard]] u32 get_worker_count() const { return static_cast<u32>(m_queues.size()); }
+
+private:
+    struct QueuedJob {
+        Job job;
+        // The latch of the parallel_for() that submitted the job, null for submit().
+        const std::latch* batch = nullptr;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<QueuedJob> jobs;
+    };
+
+    void submit(Job job, const std::latch* batch);
+    // With a batch only that batch's jobs are taken.
+    bool run_next_job(u32 workerIndex, const std::latch* batch = nullptr);
+    void worker_loop(const std::stop_token& stopToken, u32 workerIndex);
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::atomic<u32> m_pendingJobs = 0;
+    std::atomic<u32> m_queuedJobs = 0;
+    std::atomic<u32> m_nextQueue = 0;
+    std::mutex m_wakeMutex;
+    std::condition_variable_any m_wakeCondition;
+    std::vector<std::jthread> m_threads;
+    std::thread::id m_ownerThread;
+};
@@ -1,5 +1,98 @@
 #include "application.h"
-int main()
+#include "scenes/culling.h"
+
+#include <string_view>
+
+namespace {
+    bool is_number(const std::string_view arg) {
+        return !arg.empty() && std::ranges::all_of(arg, [](const char c) { return c >= '0' && c <= '9'; });
+    }
+
+    // Pixel sizes may be fractional, signs and exponents are rejected so the value can never go negative.
+    bool is_decimal(const std::string_view arg) {
+        const auto point = arg.find('.');
+        if (point == std::string_view::npos)
+            return is_number(arg);
+        const auto whole = arg.substr(0, point);
+        const auto fraction = arg.substr(point + 1);
+        return (!whole.empty() || !fraction.empty()) && (whole.empty() || is_number(whole)) && (fraction.empty() || is_number(fraction));
+    }
+
+    void parse_import_option(const std::string_view arg, SceneImportOptions& importOptions) {
+        if (arg == "--optimize-meshes")
+            importOptions.optimizeMeshes = true;
+        else if (arg == "--pack-vertices")
+            importOptions.packVertices = true;
+        else if (arg == "--no-lods")
+            importOptions.generateLods = false;
+        else if (arg == "--no-cluster-lods")
+            importOptions.buildClusterLods = false;
+        else if (arg == "--import-stats")
+            importOptions.printStats = true;
+    }
+}
+
+int main(const int argc, char** argv)
 {
-    Application application("WCR", 1920, 1080);
+    // --bench-culling [surfaceCount] runs the CPU culling kernels without creating a window or device.
+    if (argc > 1 && std::string_view(argv[1]) == "--bench-culling") {
+        const u32 surfaceCount = argc > 2 ? static_cast<u32>(std::stoul(argv[2])) : 1024;
+        run_culling_benchmark(surfaceCount, 10000);
+        return 0;
+    }
+
+    // --cook <input.gltf> <output.wcrs> [import options] converts a glTF scene into the cooked format without
+    // creating a device.
+    if (argc > 3 && std::string_view(argv[1]) == "--cook") {
+        SceneImportOptions importOptions;
+        for (int i = 4; i < argc; i++)
+            parse_import_option(argv[i], importOptions);
+
+        JobSystem jobSystem;
+        SceneBuilder::cook_scene(argv[2], argv[3], jobSystem, importOptions);
+        return 0;
+    }
+
+    // --headless [frameCount] renders offscreen without a window or swapchain, e.g. under lavapipe.
+    // --benchmark <cameraPath> [output.csv] [frameCount] plays a camera path back and writes frame timings.
+    // --scene <path> loads a glTF or cooked scene instead of the default one.
+    // --optimize-meshes, --pack-vertices, --no-lods and --no-cluster-lods are applied to glTF scenes as they are imported,
+    // --import-stats prints what the import produced.
+    // --depth-prepass starts with the depth prepass enabled.
+    // --no-mesh-shading draws with the vertex pipeline even where task and mesh shaders are supported.
+    // --triangle-culling starts with per triangle culling of the vertex pipeline's draws enabled.
+    // --lod-error <pixels> sets the projected error the LOD and cluster selection allow, 0 always draws full detail.
+    // --min-size <pixels> culls surfaces whose bounding sphere projects to a smaller diameter, 0 keeps them all.
+    ApplicationOptions options;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg == "--headless") {
+            options.headless = true;
+            if (i + 1 < argc && is_number(argv[i + 1]))
+                options.headlessFrames = static_cast<u32>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--benchmark" && i + 1 < argc) {
+            options.benchmarkCameraPath = argv[++i];
+            if (i + 1 < argc && !is_number(argv[i + 1]) && !std::string_view(argv[i + 1]).starts_with("--"))
+                options.benchmarkOutput = argv[++i];
+            if (i + 1 < argc && is_number(argv[i + 1]))
+                options.benchmarkFrames = static_cast<u32>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--scene" && i + 1 < argc)
+            options.scenePath = argv[++i];
+        else if (arg == "--depth-prepass")
+            options.depthPrepass = true;
+        else if (arg == "--no-mesh-shading")
+            options.meshShading = false;
+        else if (arg == "--triangle-culling")
+            options.triangleCulling = true;
+        else if (arg == "--lod-error" && i + 1 < argc && is_decimal(argv[i + 1]))
+            options.lodErrorThreshold = std::max(std::stof(argv[++i]), 0.0f);
+        else if (arg == "--min-size" && i + 1 < argc && is_decimal(argv[i + 1]))
+            options.minProjectedSize = std::max(std::stof(argv[++i]), 0.0f);
+        else
+            parse_import_option(arg, options.sceneImport);
+    }
+
+    Application application("WCR", 1920, 1080, options);
 }
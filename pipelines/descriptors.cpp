@@ -21,12 +21,24 @@ vk::DescriptorSet DescriptorBuilder::build(vk::DescriptorSetLayout &layout) {
                     .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
                     .setDescriptorCount(textureCount)
                     .setStageFlags(vk::ShaderStageFlagBits::eAll),
+            vk::DescriptorSetLayoutBinding()
+                    .setBinding(storageImageBinding)
+                    .setDescriptorType(vk::DescriptorType::eStorageImage)
+                    .setDescriptorCount(storageImageCount)
+                    .setStageFlags(vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding()
+                    .setBinding(renderTargetBinding)
+                    .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                    .setDescriptorCount(renderTargetCount)
+                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
     };
 
     vk::DescriptorSetLayoutBindingFlagsCreateInfo setLayoutBindingsFlags;
     std::vector bindingFlags = {
             vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind,
             vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind,
+            vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind,
+            vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind,
     };
 
     setLayoutBindingsFlags.setBindingFlags(bindingFlags);
@@ -69,6 +81,29 @@ void DescriptorBuilder::write_image(const u32 dstArrayElement, vk::ImageView ima
     writes.push_back(write);
 }
 
+void DescriptorBuilder::write_storage_image(const u32 dstArrayElement, vk::ImageView image) {
+    const auto &imageInfo = imageInfos.emplace_back(VK_NULL_HANDLE, image, vk::ImageLayout::eGeneral);
+
+    vk::WriteDescriptorSet write(VK_NULL_HANDLE, storageImageBinding, {}, 1);
+    write.descriptorType = vk::DescriptorType::eStorageImage;
+    write.pImageInfo = &imageInfo;
+    write.dstArrayElement = dstArrayElement;
+
+    writes.push_back(write);
+}
+
+void DescriptorBuilder::write_render_target(const u32 dstArrayElement, vk::ImageView image, vk::Sampler sampler,
+                                            vk::ImageLayout layout) {
+    const auto &imageInfo = imageInfos.emplace_back(sampler, image, layout);
+
+    vk::WriteDescriptorSet write(VK_NULL_HANDLE, renderTargetBinding, {}, 1);
+    write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    write.pImageInfo = &imageInfo;
+    write.dstArrayElement = dstArrayElement;
+
+    writes.push_back(write);
+}
+
 void DescriptorBuilder::update_set(const vk::DescriptorSet &set) {
     for (auto &write: writes)
         write.dstSet = set;
@@ -76,6 +111,12 @@ void DescriptorBuilder::update_set(const vk::DescriptorSet &set) {
     const u32 writeCount = static_cast<u32>(writes.size());
 
     _device.get_handle().updateDescriptorSets(writeCount, writes.data(), 0, nullptr);
+
+    // Writes are applied immediately, so pending state is dropped to keep per-frame updates from re-applying
+    // every texture written at load time.
+    writes.clear();
+    bufferInfos.clear();
+    imageInfos.clear();
 }
 
 void DescriptorBuilder::release_descriptor_resources() const {
@@ -3,6 +3,11 @@
 
 #include <deque>
 
+// Fixed slots of the render target binding, sampled through the min-reduction depth pyramid sampler.
+static constexpr u32 DEPTH_RENDER_TARGET = 0;
+static constexpr u32 DEPTH_PYRAMID_RENDER_TARGET = 1;
+static constexpr u32 DEPTH_PYRAMID_MIP_RENDER_TARGET = 2;
+
 class DescriptorBuilder {
 
 public:
@@ -15,6 +20,10 @@ public:
 
     void write_image(u32 dstArrayElement, vk::ImageView image, vk::Sampler sampler, vk::ImageLayout layout, vk::DescriptorType type);
 
+    void write_storage_image(u32 dstArrayElement, vk::ImageView image);
+
+    void write_render_target(u32 dstArrayElement, vk::ImageView image, vk::Sampler sampler, vk::ImageLayout layout);
+
     void update_set(const vk::DescriptorSet &set);
 
 private:
@@ -26,12 +35,17 @@ private:
 
     static constexpr u32 uniformBinding = 0;
     static constexpr u32 textureBinding = 1;
+    static constexpr u32 storageImageBinding = 2;
+    static constexpr u32 renderTargetBinding = 3;
     static constexpr u32 uniformCount = 20;
     static constexpr u32 textureCount = 65536;
+    static constexpr u32 storageImageCount = 16;
+    static constexpr u32 renderTargetCount = 32;
 
     std::vector<vk::DescriptorPoolSize> poolSizes = {
         {vk::DescriptorType::eUniformBuffer, uniformCount},
-        {vk::DescriptorType::eCombinedImageSampler,  textureCount},
+        {vk::DescriptorType::eCombinedImageSampler,  textureCount + renderTargetCount},
+        {vk::DescriptorType::eStorageImage, storageImageCount},
     };
 
     vk::DescriptorPool pool;
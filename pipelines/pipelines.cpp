@@ -15,7 +15,7 @@ VkPipeline PipelineBuilder::build_pipeline(const Device& device) const {
     colorBlending.pNext = nullptr;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
+    colorBlending.attachmentCount = renderInfo.colorAttachmentCount;
     colorBlending.pAttachments = &colorBlendAttachment;
 
     VkPipelineVertexInputStateCreateInfo vertexInputCI{.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
@@ -63,6 +63,42 @@ void PipelineBuilder::set_shader(VkShaderModule vertexShader, VkShaderModule fra
     });
 }
 
+void PipelineBuilder::set_vertex_shader(VkShaderModule vertexShader) {
+    shaderStages.clear();
+    shaderStages.push_back(VkPipelineShaderStageCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertexShader,
+            .pName = "main",
+    });
+}
+
+void PipelineBuilder::set_mesh_shader(VkShaderModule taskShader, VkShaderModule meshShader, VkShaderModule fragmentShader) {
+    shaderStages.clear();
+    shaderStages.push_back(VkPipelineShaderStageCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .stage = VK_SHADER_STAGE_TASK_BIT_EXT,
+            .module = taskShader,
+            .pName = "main",
+    });
+    shaderStages.push_back(VkPipelineShaderStageCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .stage = VK_SHADER_STAGE_MESH_BIT_EXT,
+            .module = meshShader,
+            .pName = "main",
+    });
+    shaderStages.push_back(VkPipelineShaderStageCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragmentShader,
+            .pName = "main",
+    });
+}
+
 void PipelineBuilder::set_input_topology(VkPrimitiveTopology topology) {
     inputAssembly.topology = topology;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
@@ -144,3 +180,28 @@ void PipelineBuilder::disable_blending() {
     colorBlendAttachment.blendEnable = VK_FALSE;
 }
 
+void ComputePipelineBuilder::clear() {
+    shaderStage = VkPipelineShaderStageCreateInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+}
+
+VkPipeline ComputePipelineBuilder::build_pipeline(const Device& device) const {
+    VkComputePipelineCreateInfo pipelineCI{.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipelineCI.pNext = nullptr;
+    pipelineCI.stage = shaderStage;
+    pipelineCI.layout = pipelineLayout;
+
+    VkPipeline newPipeline;
+    vkCreateComputePipelines(device.get_handle(), VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &newPipeline);
+
+    return newPipeline;
+}
+
+void ComputePipelineBuilder::set_shader(VkShaderModule computeShader) {
+    shaderStage = VkPipelineShaderStageCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = computeShader,
+            .pName = "main",
+    };
+}
@@ -14,6 +14,10 @@ public:
     VkPipeline build_pipeline(const Device& device) const;
 
     void set_shader(VkShaderModule vertexShader, VkShaderModule fragmentShader);
+    // Vertex stage only, for depth only pipelines built without a colour attachment format.
+    void set_vertex_shader(VkShaderModule vertexShader);
+    // Task, mesh and fragment stages. The vertex input and input assembly state are ignored by such pipelines.
+    void set_mesh_shader(VkShaderModule taskShader, VkShaderModule meshShader, VkShaderModule fragmentShader);
     void set_input_topology(VkPrimitiveTopology topology);
     void set_polygon_mode(VkPolygonMode mode);
     void set_cull_mode(VkCullModeFlags cullMode, VkFrontFace frontFace);
@@ -37,3 +41,16 @@ public:
     VkPipelineRenderingCreateInfo renderInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
     VkFormat colorAttachmentformat{};
 };
+
+class ComputePipelineBuilder {
+public:
+    ComputePipelineBuilder() { clear(); }
+
+    void clear();
+    VkPipeline build_pipeline(const Device& device) const;
+
+    void set_shader(VkShaderModule computeShader);
+
+    VkPipelineShaderStageCreateInfo shaderStage{.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    VkPipelineLayout pipelineLayout{};
+};
@@ -0,0 +1,109 @@
+#include "profiler.h"
+
+GpuProfiler::GpuProfiler(const vk::Device device, const f32 timestampPeriod, const u32 timestampValidBits)
+    : m_device(device), m_timestampPeriod(timestampPeriod),
+      m_timestampMask(timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1)
+{
+}
+
+void GpuProfiler::begin_frame(const CommandBuffer& cmd, const vk::QueryPool queryPool, const u32 frameIndex)
+{
+    auto& frame = m_frames[frameIndex];
+    frame.queryPool = queryPool;
+    resolve(frame);
+
+    frame.scopes.clear();
+    frame.queryCount = 0;
+    m_openScopes.clear();
+    m_currentFrame = &frame;
+
+    cmd.reset_query_pool(queryPool, 0, MAX_TIMESTAMP_QUERIES);
+}
+
+void GpuProfiler::begin_scope(const CommandBuffer& cmd, const std::string_view name)
+{
+    // Scopes past the pool size are dropped, the sentinel keeps end_scope() calls balanced.
+    if (!m_currentFrame || m_currentFrame->queryCount + 2 > MAX_TIMESTAMP_QUERIES) {
+        m_openScopes.push_back(UINT32_MAX);
+        return;
+    }
+
+    const u32 beginQuery = m_currentFrame->queryCount;
+    m_currentFrame->queryCount += 2;
+    m_currentFrame->scopes.push_back({name, beginQuery, beginQuery + 1});
+    m_openScopes.push_back(static_cast<u32>(m_currentFrame->scopes.size() - 1));
+
+    cmd.write_timestamp(vk::PipelineStageFlagBits2::eAllCommands, m_currentFrame->queryPool, beginQuery);
+}
+
+void GpuProfiler::end_scope(const CommandBuffer& cmd)
+{
+    assert(!m_openScopes.empty() && "end_scope() without a matching begin_scope()");
+    const u32 scopeIndex = m_openScopes.back();
+    m_openScopes.pop_back();
+    if (scopeIndex == UINT32_MAX)
+        return;
+
+    const auto& scope = m_currentFrame->scopes[scopeIndex];
+    cmd.write_timestamp(vk::PipelineStageFlagBits2::eAllCommands, m_currentFrame->queryPool, scope.endQuery);
+}
+
+f64 GpuProfiler::get_resolved_time(const std::string_view name) const
+{
+    for (const auto& scope : m_resolvedScopes)
+        if (scope.name == name)
+            return scope.time;
+
+    return 0.0;
+}
+
+void GpuProfiler::resolve(FrameQueries& frame)
+{
+    m_resolvedScopes.clear();
+    // A queue without valid timestamp bits writes undefined values, so nothing is timed.
+    if (frame.queryCount == 0 || m_timestampMask == 0)
+        return;
+
+    // Every timestamp is followed by its availability, so scopes that never executed are skipped instead of waited on.
+    std::vector<u64> results(frame.queryCount * 2);
+    const auto result = m_device.getQueryPoolResults(
+        frame.queryPool, 0, frame.queryCount,
+        results.size() * sizeof(u64), results.data(), 2 * sizeof(u64),
+        vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+    if (result != vk::Result::eSuccess && result != vk::Result::eNotReady)
+        return;
+
+    for (const auto& [name, beginQuery, endQuery] : frame.scopes) {
+        if (results[beginQuery * 2 + 1] == 0 || results[endQuery * 2 + 1] == 0)
+            continue;
+
+        const u64 begin = results[beginQuery * 2] & m_timestampMask;
+        const u64 end = results[endQuery * 2] & m_timestampMask;
+        // Masking the difference as well keeps a scope that crossed a wrap of the counter positive.
+        const f64 time = static_cast<f64>((end - begin) & m_timestampMask) * m_timestampPeriod / 1e6;
+
+        auto& timing = get_timing(name);
+        timing.lastTime = time;
+        timing.history[timing.nextSample] = time;
+        timing.nextSample = (timing.nextSample + 1) % PROFILER_HISTORY;
+        timing.sampleCount = std::min(timing.sampleCount + 1, PROFILER_HISTORY);
+
+        f64 total = 0.0;
+        for (u32 i = 0; i < timing.sampleCount; i++)
+            total += timing.history[i];
+        timing.averageTime = total / timing.sampleCount;
+
+        m_resolvedScopes.push_back({name, time});
+    }
+}
+
+ScopeTiming& GpuProfiler::get_timing(const std::string_view name)
+{
+    for (auto& timing : m_timings)
+        if (timing.name == name)
+            return timing;
+
+    auto& timing = m_timings.emplace_back();
+    timing.name = name;
+    return timing;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "common.h"
+#include "commands.h"
+#include "device/device.h"
+
+static constexpr u32 PROFILER_HISTORY = 64;
+
+struct ScopeTiming {
+    std::string name;
+    f64 lastTime{};
+    f64 averageTime{};
+    std::array<f64, PROFILER_HISTORY> history{};
+    u32 sampleCount{};
+    u32 nextSample{};
+};
+
+struct ResolvedScope {
+    std::string_view name;
+    f64 time{};
+};
+
+// Named GPU timestamp scopes. Each frame in flight records into its own query pool, and begin_frame() resolves the
+// previous contents of that pool once its render fence has signalled, so reading results never stalls. Scope names
+// are kept as views and have to outlive the profiler, string literals are expected.
+class GpuProfiler {
+public:
+    GpuProfiler(vk::Device device, f32 timestampPeriod, u32 timestampValidBits);
+
+    void begin_frame(const CommandBuffer& cmd, vk::QueryPool queryPool, u32 frameIndex);
+    void begin_scope(const CommandBuffer& cmd, std::string_view name);
+    void end_scope(const CommandBuffer& cmd);
+
+    // Rolling averages over the last PROFILER_HISTORY resolved frames, in the order scopes were first seen.
+    [[nodiscard]] const std::vector<ScopeTiming>& get_timings() const { return m_timings; }
+    // Scopes of the frame resolved by the last begin_frame() call.
+    [[nodiscard]] std::span<const ResolvedScope> get_resolved_scopes() const { return m_resolvedScopes; }
+    [[nodiscard]] f64 get_resolved_time(std::string_view name) const;
+
+private:
+    struct RecordedScope {
+        std::string_view name;
+        u32 beginQuery{};
+        u32 endQuery{};
+    };
+
+    struct FrameQueries {
+        vk::QueryPool queryPool;
+        std::vector<RecordedScope> scopes;
+        u32 queryCount{};
+    };
+
+    void resolve(FrameQueries& frame);
+    ScopeTiming& get_timing(std::string_view name);
+
+    vk::Device m_device;
+    f32 m_timestampPeriod{};
+    // Timestamps only count in their low valid bits and wrap around past them.
+    u64 m_timestampMask{};
+    std::array<FrameQueries, MAX_FRAMES_IN_FLIGHT> m_frames{};
+    FrameQueries* m_currentFrame = nullptr;
+    std::vector<u32> m_openScopes;
+    std::vector<ScopeTiming> m_timings;
+    std::vector<ResolvedScope> m_resolvedScopes;
+};
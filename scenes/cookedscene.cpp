@@ -0,0 +1,520 @@
+#include "cookedscene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+#include <zstd.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    u64 align_section(const u64 offset) {
+        return (offset + COOKED_SECTION_ALIGNMENT - 1) & ~(COOKED_SECTION_ALIGNMENT - 1);
+    }
+}
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Failed to open " + path.string());
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to read the size of " + path.string());
+    }
+    m_size = static_cast<u64>(size.QuadPart);
+
+    m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping)
+        m_data = static_cast<const u8*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data) {
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Failed to map " + path.string());
+    }
+}
+
+MappedFile::~MappedFile() {
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    m_file = open(path.c_str(), O_RDONLY);
+    if (m_file < 0)
+        throw std::runtime_error("Failed to open " + path.string());
+
+    struct stat fileStat{};
+    if (fstat(m_file, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(m_file);
+        throw std::runtime_error("Failed to read the size of " + path.string());
+    }
+    m_size = static_cast<u64>(fileStat.st_size);
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+    if (data == MAP_FAILED) {
+        close(m_file);
+        throw std::runtime_error("Failed to map " + path.string());
+    }
+    // Every byte is copied into staging right away, so start reading ahead of the first page faults.
+    madvise(data, m_size, MADV_WILLNEED);
+    m_data = static_cast<const u8*>(data);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<u8*>(m_data), m_size);
+    close(m_file);
+}
+#endif
+
+CookedScene::CookedScene(const std::filesystem::path& path)
+    : m_file(path)
+{
+    const auto data = m_file.get_data();
+    if (data.size() < sizeof(CookedSceneHeader))
+        throw std::runtime_error("Cooked scene " + path.string() + " is truncated");
+
+    m_header = reinterpret_cast<const CookedSceneHeader*>(data.data());
+    if (m_header->magic != COOKED_SCENE_MAGIC)
+        throw std::runtime_error(path.string() + " is not a cooked scene");
+    if (m_header->version != COOKED_SCENE_VERSION)
+        throw std::runtime_error("Cooked scene " + path.string() + " has version " + std::to_string(m_header->version) +
+            ", expected " + std::to_string(COOKED_SCENE_VERSION) + ", recook it");
+
+    const auto in_file = [&](const u64 offset, const u64 size) {
+        return offset <= data.size() && size <= data.size() - offset;
+    };
+
+    for (const auto& [offset, size, firstChunk, chunkCount] : m_header->sections)
+        if (chunkCount == 0 && (offset % COOKED_SECTION_ALIGNMENT != 0 || !in_file(offset, size)))
+            throw std::runtime_error("Cooked scene " + path.string() + " has a malformed section table");
+
+    m_chunks = get<CookedChunk>(CookedSection::Chunks);
+
+    // Chunks of a section have to cover it back to back, read() relies on it to find a range's chunks.
+    for (const auto& [offset, size, firstChunk, chunkCount] : m_header->sections) {
+        if (chunkCount == 0)
+            continue;
+        if (static_cast<u64>(firstChunk) + chunkCount > m_chunks.size())
+            throw std::runtime_error("Cooked scene " + path.string() + " has a malformed chunk table");
+
+        u64 uncompressedOffset = 0;
+        for (const auto& chunk : m_chunks.subspan(firstChunk, chunkCount)) {
+            if (chunk.uncompressedOffset != uncompressedOffset || !in_file(chunk.offset, chunk.compressedSize))
+                throw std::runtime_error("Cooked scene " + path.string() + " has a malformed chunk table");
+            uncompressedOffset += chunk.uncompressedSize;
+        }
+        if (uncompressedOffset != size)
+            throw std::runtime_error("Cooked scene " + path.string() + " has a malformed chunk table");
+    }
+}
+
+void CookedScene::read(const CookedSection section, const u64 offset, const u64 size, u8* destination) const {
+    const auto& range = m_header->sections[static_cast<u32>(section)];
+    if (range.chunkCount == 0) {
+        if (offset > range.size || size > range.size - offset)
+            throw std::runtime_error("Cooked scene read is out of range");
+        memcpy(destination, m_file.get_data().data() + range.offset + offset, size);
+        return;
+    }
+
+    for (const auto& chunk : get_chunks(section, offset, size))
+        read_chunk(chunk, destination + (chunk.uncompressedOffset - offset));
+}
+
+void CookedScene::read(const CookedSection section, const u64 offset, const u64 size, u8* destination, JobSystem& jobSystem) const {
+    if (m_header->sections[static_cast<u32>(section)].chunkCount == 0) {
+        read(section, offset, size, destination);
+        return;
+    }
+
+    const auto chunks = get_chunks(section, offset, size);
+    std::vector<std::exception_ptr> errors(chunks.size());
+
+    jobSystem.parallel_for(static_cast<u32>(chunks.size()), [&](const u32 i, u32) {
+        try {
+            read_chunk(chunks[i], destination + (chunks[i].uncompressedOffset - offset));
+        }
+        catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+
+    for (const auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+}
+
+std::span<const CookedChunk> CookedScene::get_chunks(const CookedSection section, const u64 offset, const u64 size) const {
+    const auto& range = m_header->sections[static_cast<u32>(section)];
+    if (offset > range.size || size > range.size - offset)
+        throw std::runtime_error("Cooked scene read is out of range");
+
+    const auto chunks = m_chunks.subspan(range.firstChunk, range.chunkCount);
+    const auto first = std::ranges::lower_bound(chunks, offset, {}, &CookedChunk::uncompressedOffset);
+    const auto last = std::ranges::lower_bound(chunks, offset + size, {}, &CookedChunk::uncompressedOffset);
+
+    const bool startsOnChunk = first == chunks.end() ? offset == range.size : first->uncompressedOffset == offset;
+    const bool endsOnChunk = last == chunks.end() ? offset + size == range.size : last->uncompressedOffset == offset + size;
+    if (!startsOnChunk || !endsOnChunk)
+        throw std::runtime_error("Cooked scene read does not start and end on chunk boundaries");
+
+    return {first, last};
+}
+
+void CookedScene::read_chunk(const CookedChunk& chunk, u8* destination) const {
+    const u8* source = m_file.get_data().data() + chunk.offset;
+    if (chunk.compressedSize == chunk.uncompressedSize) {
+        memcpy(destination, source, chunk.uncompressedSize);
+        return;
+    }
+
+    // One context per thread, so parallel reads never allocate one per chunk.
+    thread_local const std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> context(ZSTD_createDCtx(), &ZSTD_freeDCtx);
+    const size_t result = ZSTD_decompressDCtx(context.get(), destination, chunk.uncompressedSize, source, chunk.compressedSize);
+    if (ZSTD_isError(result) || result != chunk.uncompressedSize)
+        throw std::runtime_error("Failed to decompress cooked scene chunk");
+}
+
+CookedSceneWriter::CookedSceneWriter(const u32 firstNode, const VertexFormat vertexFormat) {
+    m_header.magic = COOKED_SCENE_MAGIC;
+    m_header.version = COOKED_SCENE_VERSION;
+    m_header.firstNode = firstNode;
+    m_header.vertexFormat = vertexFormat;
+}
+
+std::span<u8> CookedSceneWriter::allocate(const CookedSection section, const u64 size) {
+    auto& data = m_sections[static_cast<u32>(section)];
+    data.assign(size, 0);
+    return data;
+}
+
+void CookedSceneWriter::compress(const CookedSection section, std::vector<u64> boundaries) {
+    m_compressed[static_cast<u32>(section)] = true;
+    m_boundaries[static_cast<u32>(section)] = std::move(boundaries);
+}
+
+void CookedSceneWriter::write(const std::filesystem::path& path, JobSystem& jobSystem) const {
+    CookedSceneHeader header = m_header;
+
+    // Split every compressed section at its boundaries and at least every COOKED_CHUNK_SIZE bytes.
+    std::vector<CookedChunk> chunks;
+    std::vector<u32> chunkSections;
+    for (u32 section = 0; section < SECTION_COUNT; section++) {
+        if (!m_compressed[section])
+            continue;
+
+        const u64 sectionSize = m_sections[section].size();
+        auto boundaries = m_boundaries[section];
+        boundaries.push_back(sectionSize);
+        std::ranges::sort(boundaries);
+
+        auto& range = header.sections[section];
+        range.size = sectionSize;
+        range.firstChunk = static_cast<u32>(chunks.size());
+
+        u64 start = 0;
+        for (const u64 boundary : boundaries) {
+            while (start < std::min(boundary, sectionSize)) {
+                const u64 size = std::min(boundary - start, COOKED_CHUNK_SIZE);
+                chunks.push_back({0, 0, start, size});
+                chunkSections.push_back(section);
+                start += size;
+            }
+        }
+        range.chunkCount = static_cast<u32>(chunks.size()) - range.firstChunk;
+    }
+
+    std::vector<std::vector<u8>> compressedChunks(chunks.size());
+    jobSystem.parallel_for(static_cast<u32>(chunks.size()), [&](const u32 i, u32) {
+        const u8* source = m_sections[chunkSections[i]].data() + chunks[i].uncompressedOffset;
+        const u64 size = chunks[i].uncompressedSize;
+
+        auto& compressed = compressedChunks[i];
+        compressed.resize(ZSTD_compressBound(size));
+        const size_t compressedSize = ZSTD_compress(compressed.data(), compressed.size(), source, size, COOKED_ZSTD_LEVEL);
+        if (ZSTD_isError(compressedSize) || compressedSize >= size)
+            compressed.assign(source, source + size);
+        else
+            compressed.resize(compressedSize);
+    });
+
+    // Uncompressed sections first, then the chunk table and the chunk data.
+    u64 offset = align_section(sizeof(CookedSceneHeader));
+    for (u32 section = 0; section < SECTION_COUNT; section++) {
+        if (m_compressed[section] || section == static_cast<u32>(CookedSection::Chunks))
+            continue;
+        header.sections[section].offset = offset;
+        header.sections[section].size = m_sections[section].size();
+        offset = align_section(offset + m_sections[section].size());
+    }
+
+    auto& chunkTable = header.sections[static_cast<u32>(CookedSection::Chunks)];
+    chunkTable.offset = offset;
+    chunkTable.size = chunks.size() * sizeof(CookedChunk);
+    offset = align_section(offset + chunkTable.size);
+
+    for (u64 i = 0; i < chunks.size(); i++) {
+        chunks[i].offset = offset;
+        chunks[i].compressedSize = compressedChunks[i].size();
+        offset = align_section(offset + chunks[i].compressedSize);
+    }
+    for (u32 section = 0; section < SECTION_COUNT; section++) {
+        auto& range = header.sections[section];
+        if (range.chunkCount > 0)
+            range.offset = chunks[range.firstChunk].offset;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open " + path.string() + " for writing");
+
+    constexpr std::array<char, COOKED_SECTION_ALIGNMENT> padding{};
+    const auto write_aligned = [&](const void* data, const u64 size) {
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        file.write(padding.data(), static_cast<std::streamsize>(align_section(size) - size));
+    };
+
+    write_aligned(&header, sizeof(CookedSceneHeader));
+    for (u32 section = 0; section < SECTION_COUNT; section++)
+        if (!m_compressed[section] && section != static_cast<u32>(CookedSection::Chunks))
+            write_aligned(m_sections[section].data(), m_sections[section].size());
+    write_aligned(chunks.data(), chunkTable.size);
+    for (const auto& compressed : compressedChunks)
+        write_aligned(compressed.data(), compressed.size());
+
+    if (!file)
+        throw std::runtime_error("Failed to write " + path.string());
+
+    u64 compressedSize = 0;
+    u64 uncompressedSize = 0;
+    for (const auto& chunk : chunks) {
+        compressedSize += chunk.compressedSize;
+        uncompressedSize += chunk.uncompressedSize;
+    }
+    std::println("Compressed {} chunks from {:.1f} MiB to {:.1f} MiB", chunks.size(),
+        static_cast<f64>(uncompressedSize) / (1 << 20), static_cast<f64>(compressedSize) / (1 << 20));
+}
+
+void SceneBuilder::cook_scene(const std::filesystem::path& gltfPath, const std::filesystem::path& outputPath, JobSystem& jobSystem, const SceneImportOptions& importOptions) {
+    const auto cookStart = std::chrono::steady_clock::now();
+    const auto gltf = parse_gltf(gltfPath);
+    if (!gltf.has_value())
+        throw std::runtime_error("Failed to parse scene " + gltfPath.string());
+    const auto& asset = gltf.value();
+
+    Scene scene;
+    ResourceData resourceData;
+    const auto textureData = ktx_texture_data_from_gltf(asset, jobSystem);
+    const auto& [texturePs, copyRegions] = textureData;
+
+    const auto destroyTextures = [&] {
+        for (const auto texture : texturePs)
+            ktxTexture_Destroy(texture);
+    };
+
+    try {
+        const auto geoData = create_meshes(asset, scene, resourceData, importOptions);
+        create_materials(asset, scene, resourceData);
+        create_lights(asset, scene, resourceData);
+        const auto samplerInfos = create_sampler_infos(asset, scene, resourceData);
+        create_nodes(asset, scene, resourceData);
+        const auto textureInfos = create_texture_infos(texturePs, scene, resourceData);
+
+        CookedSceneWriter writer(scene.firstNode, resourceData.vertexFormat);
+        writer.add<u8>(CookedSection::Vertices, geoData.get_vertex_data());
+        writer.add<u32>(CookedSection::Positions, geoData.positions);
+        writer.add<u32>(CookedSection::Indices, geoData.indices);
+        writer.add<u16>(CookedSection::Indices16, geoData.indices16);
+        writer.add<Meshlet>(CookedSection::Meshlets, geoData.meshlets);
+        writer.add<u32>(CookedSection::MeshletData, geoData.meshletData);
+        writer.compress(CookedSection::Vertices);
+        writer.compress(CookedSection::Positions);
+        writer.compress(CookedSection::Indices);
+        writer.compress(CookedSection::Indices16);
+        writer.compress(CookedSection::Meshlets);
+        writer.compress(CookedSection::MeshletData);
+
+        std::vector<Surface> surfaces;
+        std::vector<u32> surfaceCounts;
+        surfaceCounts.reserve(resourceData.meshes.size());
+        for (const auto& mesh : resourceData.meshes) {
+            surfaces.insert(surfaces.end(), mesh.surfaces.begin(), mesh.surfaces.end());
+            surfaceCounts.push_back(static_cast<u32>(mesh.surfaces.size()));
+        }
+        writer.add<Surface>(CookedSection::Surfaces, surfaces);
+        writer.add<u32>(CookedSection::MeshSurfaceCounts, surfaceCounts);
+        writer.add<u16>(CookedSection::MeshMetadata, resourceData.meshMetadata);
+
+        writer.add<Material>(CookedSection::Materials, resourceData.materials);
+        writer.add<u16>(CookedSection::MaterialMetadata, resourceData.materialMetadata);
+        writer.add<Light>(CookedSection::Lights, resourceData.lights);
+        writer.add<u16>(CookedSection::LightMetadata, resourceData.lightMetadata);
+        writer.add<char>(CookedSection::LightNames, resourceData.lightNames);
+        writer.add<SamplerInfo>(CookedSection::Samplers, samplerInfos);
+        writer.add<u16>(CookedSection::SamplerMetadata, resourceData.samplerMetadata);
+
+        writer.add<Node>(CookedSection::Nodes, resourceData.nodes);
+        writer.add<u16>(CookedSection::NodeMetadata, resourceData.nodeMetadata);
+        writer.add<glm::mat4>(CookedSection::NodeLocalMatrices, resourceData.nodeLocalMatrices);
+        writer.add<glm::mat4>(CookedSection::NodeWorldMatrices, resourceData.nodeWorldMatrices);
+        writer.add<u32>(CookedSection::NodeParents, resourceData.nodeParents);
+
+        writer.add<NodeHandle>(CookedSection::SceneNodes, scene.nodes);
+        writer.add<NodeHandle>(CookedSection::SceneRenderableNodes, scene.renderableNodes);
+        writer.add<NodeHandle>(CookedSection::SceneOpaqueNodes, scene.opaqueNodes);
+        writer.add<NodeHandle>(CookedSection::SceneTransparentNodes, scene.transparentNodes);
+        writer.add<NodeHandle>(CookedSection::SceneLightNodes, scene.lightNodes);
+        writer.add<MeshHandle>(CookedSection::SceneMeshes, scene.meshes);
+        writer.add<MaterialHandle>(CookedSection::SceneMaterials, scene.materials);
+        writer.add<SamplerHandle>(CookedSection::SceneSamplers, scene.samplers);
+        writer.add<TextureHandle>(CookedSection::SceneTextures, scene.textures);
+        writer.add<LightHandle>(CookedSection::SceneLights, scene.lights);
+
+        // Texture data is laid out exactly as upload_textures() places it in staging.
+        std::vector<CookedTexture> cookedTextures(texturePs.size());
+        std::vector<vk::BufferImageCopy> regions;
+        u64 textureDataSize = 0;
+        for (u64 i = 0; i < texturePs.size(); i++) {
+            auto& cookedTexture = cookedTextures[i];
+            cookedTexture.info = textureInfos[i];
+            cookedTexture.firstRegion = static_cast<u32>(regions.size());
+            cookedTexture.regionCount = static_cast<u32>(copyRegions[i].size());
+            cookedTexture.dataOffset = textureDataSize;
+            cookedTexture.dataSize = texturePs[i]->dataSize;
+
+            regions.insert(regions.end(), copyRegions[i].begin(), copyRegions[i].end());
+            textureDataSize += align_section(cookedTexture.dataSize);
+        }
+        writer.add<CookedTexture>(CookedSection::Textures, cookedTextures);
+        writer.add<vk::BufferImageCopy>(CookedSection::TextureRegions, regions);
+        writer.add<u16>(CookedSection::TextureMetadata, resourceData.texturesMetadata);
+
+        const auto textureBytes = writer.allocate(CookedSection::TextureData, textureDataSize);
+        jobSystem.parallel_for(static_cast<u32>(texturePs.size()), [&](const u32 i, u32) {
+            const ktxTexture* texture = texturePs[i];
+            memcpy(textureBytes.data() + cookedTextures[i].dataOffset, texture->pData, texture->dataSize);
+        });
+
+        // Chunks start at every texture so each one is decompressed on its own.
+        std::vector<u64> textureOffsets(cookedTextures.size());
+        std::ranges::transform(cookedTextures, textureOffsets.begin(), &CookedTexture::dataOffset);
+        writer.compress(CookedSection::TextureData, std::move(textureOffsets));
+
+        writer.write(outputPath, jobSystem);
+    }
+    catch (...) {
+        destroyTextures();
+        throw;
+    }
+    destroyTextures();
+
+    const auto cookTime = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - cookStart);
+    std::println("Cooked {} into {} in {:.1f} ms", gltfPath.string(), outputPath.string(), cookTime.count());
+}
+
+std::optional<SceneHandle> SceneBuilder::build_scene(const CookedScene& cookedScene) {
+    auto& resourceData = *m_resourceData;
+
+    // Cooked handles index from zero, so the scene is always built into an empty ResourceData (see load_scene()).
+    const auto copy = [&]<typename T>(std::vector<T>& target, const CookedSection section) {
+        const auto data = cookedScene.get<T>(section);
+        target.assign(data.begin(), data.end());
+    };
+
+    Scene scene;
+    scene.firstNode = cookedScene.get_first_node();
+    resourceData.vertexFormat = cookedScene.get_vertex_format();
+    copy(scene.nodes, CookedSection::SceneNodes);
+    copy(scene.renderableNodes, CookedSection::SceneRenderableNodes);
+    copy(scene.opaqueNodes, CookedSection::SceneOpaqueNodes);
+    copy(scene.transparentNodes, CookedSection::SceneTransparentNodes);
+    copy(scene.lightNodes, CookedSection::SceneLightNodes);
+    copy(scene.meshes, CookedSection::SceneMeshes);
+    copy(scene.materials, CookedSection::SceneMaterials);
+    copy(scene.samplers, CookedSection::SceneSamplers);
+    copy(scene.textures, CookedSection::SceneTextures);
+    copy(scene.lights, CookedSection::SceneLights);
+
+    copy(resourceData.nodes, CookedSection::Nodes);
+    copy(resourceData.nodeMetadata, CookedSection::NodeMetadata);
+    copy(resourceData.nodeLocalMatrices, CookedSection::NodeLocalMatrices);
+    copy(resourceData.nodeWorldMatrices, CookedSection::NodeWorldMatrices);
+    copy(resourceData.nodeParents, CookedSection::NodeParents);
+    resourceData.nodeDirty.assign(resourceData.nodes.size(), true);
+
+    const auto surfaces = cookedScene.get<Surface>(CookedSection::Surfaces);
+    const auto surfaceCounts = cookedScene.get<u32>(CookedSection::MeshSurfaceCounts);
+    resourceData.meshes.resize(surfaceCounts.size());
+    u64 firstSurface = 0;
+    for (u64 i = 0; i < surfaceCounts.size(); i++) {
+        if (firstSurface + surfaceCounts[i] > surfaces.size())
+            throw std::runtime_error("Cooked scene mesh surfaces are out of range");
+        resourceData.meshes[i].surfaces.assign(surfaces.begin() + firstSurface, surfaces.begin() + firstSurface + surfaceCounts[i]);
+        firstSurface += surfaceCounts[i];
+    }
+    copy(resourceData.meshMetadata, CookedSection::MeshMetadata);
+
+    copy(resourceData.materials, CookedSection::Materials);
+    copy(resourceData.materialMetadata, CookedSection::MaterialMetadata);
+    copy(resourceData.lights, CookedSection::Lights);
+    copy(resourceData.lightMetadata, CookedSection::LightMetadata);
+    const auto lightNames = cookedScene.get<char>(CookedSection::LightNames);
+    resourceData.lightNames.assign(lightNames.begin(), lightNames.end());
+    copy(resourceData.samplerMetadata, CookedSection::SamplerMetadata);
+    copy(resourceData.texturesMetadata, CookedSection::TextureMetadata);
+
+    const auto cookedTextures = cookedScene.get<CookedTexture>(CookedSection::Textures);
+    const auto regions = cookedScene.get<vk::BufferImageCopy>(CookedSection::TextureRegions);
+    const u64 textureDataSize = cookedScene.get_size(CookedSection::TextureData);
+
+    std::vector<TextureInfo> textureInfos(cookedTextures.size());
+    std::vector<TextureUpload> uploads(cookedTextures.size());
+    for (u64 i = 0; i < cookedTextures.size(); i++) {
+        const auto& [info, firstRegion, regionCount, padding, dataOffset, dataSize] = cookedTextures[i];
+        if (static_cast<u64>(firstRegion) + regionCount > regions.size() || dataOffset > textureDataSize || align_section(dataSize) > textureDataSize - dataOffset)
+            throw std::runtime_error("Cooked scene texture is out of range");
+
+        // Padding included, chunks end where the next texture starts.
+        textureInfos[i] = info;
+        uploads[i] = {align_section(dataSize), regions.subspan(firstRegion, regionCount)};
+    }
+
+    create_samplers(cookedScene.get<SamplerInfo>(CookedSection::Samplers));
+    create_images(textureInfos);
+
+    // Geometry segments are decompressed chunk parallel from this thread, textures one per job.
+    const auto stream = [&](const CookedSection section) {
+        return GeometryStream{cookedScene.get_size(section), [&cookedScene, section, this](const u64 offset, const u64 size, u8* destination) {
+            cookedScene.read(section, offset, size, destination, m_jobSystem);
+        }};
+    };
+    upload_scene_buffers(GeometryStreams{
+        stream(CookedSection::Vertices),
+        stream(CookedSection::Positions),
+        stream(CookedSection::Indices),
+        stream(CookedSection::Indices16),
+        stream(CookedSection::Meshlets),
+        stream(CookedSection::MeshletData)
+    });
+    upload_textures(uploads, [&](const u64 index, u8* destination) {
+        cookedScene.read(CookedSection::TextureData, cookedTextures[index].dataOffset, uploads[index].size, destination);
+    });
+
+    return add_scene(std::move(scene));
+}
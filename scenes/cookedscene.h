@@ -0,0 +1,187 @@
+#pragma once
+#include "scenemanager.h"
+
+#include <array>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+static constexpr u32 COOKED_SCENE_MAGIC = 0x53524357; // "WCRS"
+static constexpr u32 COOKED_SCENE_VERSION = 10;
+static constexpr std::string_view COOKED_SCENE_EXTENSION = ".wcrs";
+static constexpr u64 COOKED_SECTION_ALIGNMENT = 16;
+// Geometry staging segments hold whole chunks, so a chunk is never split across two uploads.
+static constexpr u64 COOKED_CHUNK_SIZE = 4ull << 20;
+static constexpr i32 COOKED_ZSTD_LEVEL = 19;
+static_assert((STAGING_RING_SIZE / STAGING_RING_SEGMENTS) % COOKED_CHUNK_SIZE == 0);
+
+// Every section is a tightly packed array of the type its SceneBuilder counterpart stores, so loading is a copy from
+// the mapping with no per element work. The layout is that of the cooking machine; recook after changing any of
+// the stored structs and bump COOKED_SCENE_VERSION. The geometry and texture payloads are stored as zstd chunks.
+enum class CookedSection : u32 {
+    Vertices,           // Vertex, or packed words, see CookedSceneHeader::vertexFormat
+    Positions,          // u32, FULL_POSITION_WORDS or PACKED_POSITION_WORDS per vertex
+    Indices,            // u32
+    Indices16,          // u16
+    Meshlets,           // Meshlet
+    MeshletData,        // u32, see Meshlet::dataOffset
+    Surfaces,           // Surface, every mesh's surfaces back to back
+    MeshSurfaceCounts,  // u32 per mesh
+    MeshMetadata,       // u16
+    Materials,          // Material
+    MaterialMetadata,   // u16
+    Lights,             // Light
+    LightMetadata,      // u16
+    LightNames,         // char, ResourceData::lightNames
+    Samplers,           // SamplerInfo
+    SamplerMetadata,    // u16
+    Textures,           // CookedTexture
+    TextureRegions,     // vk::BufferImageCopy, relative to the start of their texture's data
+    TextureMetadata,    // u16
+    TextureData,        // u8, each texture 16 byte aligned for BC7 copies
+    Nodes,              // Node
+    NodeMetadata,       // u16
+    NodeLocalMatrices,  // glm::mat4
+    NodeWorldMatrices,  // glm::mat4
+    NodeParents,        // u32
+    SceneNodes,         // NodeHandle
+    SceneRenderableNodes,
+    SceneOpaqueNodes,
+    SceneTransparentNodes,
+    SceneLightNodes,
+    SceneMeshes,        // MeshHandle
+    SceneMaterials,     // MaterialHandle
+    SceneSamplers,      // SamplerHandle
+    SceneTextures,      // TextureHandle
+    SceneLights,        // LightHandle
+    Chunks,             // CookedChunk of every compressed section
+    Count
+};
+
+struct CookedSectionRange {
+    // From the start of the file, for compressed sections the data of the first chunk.
+    u64 offset{};
+    // Uncompressed.
+    u64 size{};
+    // Range of the Chunks section, a section without chunks is stored uncompressed.
+    u32 firstChunk{};
+    u32 chunkCount{};
+};
+
+// Independently compressed part of a section, so chunks can be decompressed in parallel straight into staging. A chunk
+// whose compressed size equals its uncompressed size did not compress and is stored as is.
+struct CookedChunk {
+    // From the start of the file.
+    u64 offset{};
+    u64 compressedSize{};
+    // From the start of the uncompressed section.
+    u64 uncompressedOffset{};
+    u64 uncompressedSize{};
+};
+
+struct CookedSceneHeader {
+    u32 magic{};
+    u32 version{};
+    u32 firstNode{};
+    VertexFormat vertexFormat{};
+    std::array<CookedSectionRange, static_cast<u32>(CookedSection::Count)> sections{};
+};
+
+struct CookedTexture {
+    TextureInfo info{};
+    u32 firstRegion{};
+    u32 regionCount{};
+    u32 padding{};
+    // From the start of the TextureData section.
+    u64 dataOffset{};
+    u64 dataSize{};
+};
+
+// Read only memory mapping of a whole file.
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    [[nodiscard]] std::span<const u8> get_data() const { return {m_data, m_size}; }
+
+private:
+    const u8* m_data = nullptr;
+    u64 m_size{};
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#else
+    int m_file = -1;
+#endif
+};
+
+// A mapped cooked scene file. The header, section ranges and chunk table are validated on open, section contents are not.
+class CookedScene {
+public:
+    explicit CookedScene(const std::filesystem::path& path);
+
+    // Views an uncompressed section in place.
+    template<typename T>
+    [[nodiscard]] std::span<const T> get(const CookedSection section) const {
+        static_assert(std::is_trivially_copyable_v<T>, "Cooked sections are read back as raw bytes");
+        const auto& range = m_header->sections[static_cast<u32>(section)];
+        if (range.chunkCount > 0)
+            throw std::runtime_error("Cooked scene section is compressed, it has to be read");
+        if (range.size % sizeof(T) != 0)
+            throw std::runtime_error("Malformed cooked scene section");
+        return {reinterpret_cast<const T*>(m_file.get_data().data() + range.offset), range.size / sizeof(T)};
+    }
+
+    [[nodiscard]] u64 get_size(const CookedSection section) const { return m_header->sections[static_cast<u32>(section)].size; }
+    [[nodiscard]] u32 get_first_node() const { return m_header->firstNode; }
+    [[nodiscard]] VertexFormat get_vertex_format() const { return m_header->vertexFormat; }
+
+    // Decompresses or copies size bytes of a section from offset to destination. In compressed sections the range has
+    // to start and end on chunk boundaries. The job system overload decompresses the chunks in parallel, it must not
+    // be called from a job.
+    void read(CookedSection section, u64 offset, u64 size, u8* destination) const;
+    void read(CookedSection section, u64 offset, u64 size, u8* destination, JobSystem& jobSystem) const;
+
+private:
+    [[nodiscard]] std::span<const CookedChunk> get_chunks(CookedSection section, u64 offset, u64 size) const;
+    void read_chunk(const CookedChunk& chunk, u8* destination) const;
+
+    MappedFile m_file;
+    const CookedSceneHeader* m_header = nullptr;
+    std::span<const CookedChunk> m_chunks;
+};
+
+// Collects the sections of a cooked scene in memory and writes them out behind the header, followed by the chunk
+// table and the chunks of the compressed sections.
+class CookedSceneWriter {
+public:
+    CookedSceneWriter(u32 firstNode, VertexFormat vertexFormat);
+
+    template<typename T>
+    void add(const CookedSection section, const std::span<const T> data) {
+        static_assert(std::is_trivially_copyable_v<T>, "Cooked sections are written as raw bytes");
+        const auto bytes = allocate(section, data.size_bytes());
+        if (!data.empty())
+            memcpy(bytes.data(), data.data(), data.size_bytes());
+    }
+
+    // Reserves the section so its contents can be written in place.
+    std::span<u8> allocate(CookedSection section, u64 size);
+    // Stores the section as zstd chunks of at most COOKED_CHUNK_SIZE bytes. No chunk crosses one of the boundaries,
+    // so every range between two of them can be read on its own.
+    void compress(CookedSection section, std::vector<u64> boundaries = {});
+    // Compresses the chunks on the job system's workers, then writes the file.
+    void write(const std::filesystem::path& path, JobSystem& jobSystem) const;
+
+private:
+    static constexpr u32 SECTION_COUNT = static_cast<u32>(CookedSection::Count);
+
+    CookedSceneHeader m_header{};
+    std::array<std::vector<u8>, SECTION_COUNT> m_sections;
+    std::array<bool, SECTION_COUNT> m_compressed{};
+    std::array<std::vector<u64>, SECTION_COUNT> m_boundaries;
+};
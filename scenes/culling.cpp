@@ -0,0 +1,270 @@
+#include "culling.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <bit>
+#include <chrono>
+#include <random>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define WCR_CULLING_X86
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define WCR_TARGET_AVX2
+    #else
+        #define WCR_TARGET_AVX2 __attribute__((target("avx2,fma")))
+    #endif
+#endif
+
+void SurfaceBounds::resize(const u32 surfaceCount) {
+    count = surfaceCount;
+    const u32 paddedCount = (surfaceCount + CULL_BATCH_WIDTH - 1) / CULL_BATCH_WIDTH * CULL_BATCH_WIDTH + CULL_BATCH_WIDTH;
+    for (auto* component : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+        component->assign(paddedCount, 0.0f);
+}
+
+void SurfaceBounds::set(const u32 index, const glm::vec3 &center, const glm::vec3 &extent) {
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    extentX[index] = extent.x;
+    extentY[index] = extent.y;
+    extentZ[index] = extent.z;
+}
+
+Frustum compute_frustum(const glm::mat4 &viewProjection) {
+    const glm::mat4 transpose = glm::transpose(viewProjection);
+
+    const Plane leftPlane = transpose[3] + transpose[0];
+    const Plane rightPlane = transpose[3] - transpose[0];
+    const Plane bottomPlane = transpose[3] + transpose[1];
+    const Plane topPlane = transpose[3] - transpose[1];
+    const Plane nearPlane = transpose[3] + transpose[2];
+
+    return {leftPlane, rightPlane, bottomPlane, topPlane, nearPlane};
+}
+
+// Center-extent test: a box is outside a plane when its center lies further behind it than the box's projected
+// half size along the plane normal.
+static u32 frustum_cull_scalar(const Frustum &frustum, const SurfaceBounds &bounds, const u32 first, const u32 last, u32 *visibleIndices) {
+    u32 visibleCount = 0;
+    for (u32 i = first; i < last; i++) {
+        bool visible = true;
+        for (const auto& plane : frustum) {
+            const f32 distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+            const f32 radius = std::abs(plane.x) * bounds.extentX[i] + std::abs(plane.y) * bounds.extentY[i] + std::abs(plane.z) * bounds.extentZ[i];
+            if (distance + radius < 0.0f) {
+                visible = false;
+                break;
+            }
+        }
+
+        if (visible)
+            visibleIndices[visibleCount++] = i;
+    }
+
+    return visibleCount;
+}
+
+#ifdef WCR_CULLING_X86
+static u32 frustum_cull_sse(const Frustum &frustum, const SurfaceBounds &bounds, const u32 first, const u32 last, u32 *visibleIndices) {
+    constexpr u32 width = 4;
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 planeX[5], planeY[5], planeZ[5], planeW[5];
+    __m128 absPlaneX[5], absPlaneY[5], absPlaneZ[5];
+    for (u32 p = 0; p < 5; p++) {
+        planeX[p] = _mm_set1_ps(frustum[p].x);
+        planeY[p] = _mm_set1_ps(frustum[p].y);
+        planeZ[p] = _mm_set1_ps(frustum[p].z);
+        planeW[p] = _mm_set1_ps(frustum[p].w);
+        absPlaneX[p] = _mm_andnot_ps(signMask, planeX[p]);
+        absPlaneY[p] = _mm_andnot_ps(signMask, planeY[p]);
+        absPlaneZ[p] = _mm_andnot_ps(signMask, planeZ[p]);
+    }
+
+    u32 visibleCount = 0;
+    for (u32 base = first; base < last; base += width) {
+        const __m128 centerX = _mm_loadu_ps(&bounds.centerX[base]);
+        const __m128 centerY = _mm_loadu_ps(&bounds.centerY[base]);
+        const __m128 centerZ = _mm_loadu_ps(&bounds.centerZ[base]);
+        const __m128 extentX = _mm_loadu_ps(&bounds.extentX[base]);
+        const __m128 extentY = _mm_loadu_ps(&bounds.extentY[base]);
+        const __m128 extentZ = _mm_loadu_ps(&bounds.extentZ[base]);
+
+        __m128 outside = _mm_setzero_ps();
+        for (u32 p = 0; p < 5; p++) {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], centerX), planeW[p]);
+            distance = _mm_add_ps(_mm_mul_ps(planeY[p], centerY), distance);
+            distance = _mm_add_ps(_mm_mul_ps(planeZ[p], centerZ), distance);
+            distance = _mm_add_ps(_mm_mul_ps(absPlaneX[p], extentX), distance);
+            distance = _mm_add_ps(_mm_mul_ps(absPlaneY[p], extentY), distance);
+            distance = _mm_add_ps(_mm_mul_ps(absPlaneZ[p], extentZ), distance);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+        }
+
+        u32 visibleMask = ~static_cast<u32>(_mm_movemask_ps(outside)) & 0xF;
+        if (const u32 remaining = last - base; remaining < width)
+            visibleMask &= (1u << remaining) - 1;
+
+        while (visibleMask) {
+            visibleIndices[visibleCount++] = base + std::countr_zero(visibleMask);
+            visibleMask &= visibleMask - 1;
+        }
+    }
+
+    return visibleCount;
+}
+
+WCR_TARGET_AVX2
+static u32 frustum_cull_avx2(const Frustum &frustum, const SurfaceBounds &bounds, const u32 first, const u32 last, u32 *visibleIndices) {
+    constexpr u32 width = 8;
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    __m256 planeX[5], planeY[5], planeZ[5], planeW[5];
+    __m256 absPlaneX[5], absPlaneY[5], absPlaneZ[5];
+    for (u32 p = 0; p < 5; p++) {
+        planeX[p] = _mm256_set1_ps(frustum[p].x);
+        planeY[p] = _mm256_set1_ps(frustum[p].y);
+        planeZ[p] = _mm256_set1_ps(frustum[p].z);
+        planeW[p] = _mm256_set1_ps(frustum[p].w);
+        absPlaneX[p] = _mm256_andnot_ps(signMask, planeX[p]);
+        absPlaneY[p] = _mm256_andnot_ps(signMask, planeY[p]);
+        absPlaneZ[p] = _mm256_andnot_ps(signMask, planeZ[p]);
+    }
+
+    u32 visibleCount = 0;
+    for (u32 base = first; base < last; base += width) {
+        const __m256 centerX = _mm256_loadu_ps(&bounds.centerX[base]);
+        const __m256 centerY = _mm256_loadu_ps(&bounds.centerY[base]);
+        const __m256 centerZ = _mm256_loadu_ps(&bounds.centerZ[base]);
+        const __m256 extentX = _mm256_loadu_ps(&bounds.extentX[base]);
+        const __m256 extentY = _mm256_loadu_ps(&bounds.extentY[base]);
+        const __m256 extentZ = _mm256_loadu_ps(&bounds.extentZ[base]);
+
+        __m256 outside = _mm256_setzero_ps();
+        for (u32 p = 0; p < 5; p++) {
+            __m256 distance = _mm256_fmadd_ps(planeX[p], centerX, planeW[p]);
+            distance = _mm256_fmadd_ps(planeY[p], centerY, distance);
+            distance = _mm256_fmadd_ps(planeZ[p], centerZ, distance);
+            distance = _mm256_fmadd_ps(absPlaneX[p], extentX, distance);
+            distance = _mm256_fmadd_ps(absPlaneY[p], extentY, distance);
+            distance = _mm256_fmadd_ps(absPlaneZ[p], extentZ, distance);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+        }
+
+        u32 visibleMask = ~static_cast<u32>(_mm256_movemask_ps(outside)) & 0xFF;
+        if (const u32 remaining = last - base; remaining < width)
+            visibleMask &= (1u << remaining) - 1;
+
+        while (visibleMask) {
+            visibleIndices[visibleCount++] = base + std::countr_zero(visibleMask);
+            visibleMask &= visibleMask - 1;
+        }
+    }
+
+    return visibleCount;
+}
+
+static bool cpu_supports_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    if (!osxsave || !fma || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+CullKernel get_best_cull_kernel() {
+#ifdef WCR_CULLING_X86
+    static const CullKernel bestKernel = cpu_supports_avx2() ? CullKernel::AVX2 : CullKernel::SSE;
+    return bestKernel;
+#else
+    return CullKernel::Scalar;
+#endif
+}
+
+const char* get_cull_kernel_name(const CullKernel kernel) {
+    switch (kernel) {
+        case CullKernel::Scalar: return "Scalar";
+        case CullKernel::SSE: return "SSE";
+        case CullKernel::AVX2: return "AVX2";
+    }
+    return "Unknown";
+}
+
+u32 frustum_cull_bounds(const Frustum &frustum, const SurfaceBounds &bounds, u32 *visibleIndices) {
+    return frustum_cull_bounds(frustum, bounds, 0, bounds.count, visibleIndices, get_best_cull_kernel());
+}
+
+u32 frustum_cull_bounds(const Frustum &frustum, const SurfaceBounds &bounds, const u32 first, const u32 count, u32 *visibleIndices) {
+    return frustum_cull_bounds(frustum, bounds, first, count, visibleIndices, get_best_cull_kernel());
+}
+
+u32 frustum_cull_bounds(const Frustum &frustum, const SurfaceBounds &bounds, const u32 first, const u32 count,
+                        u32 *visibleIndices, const CullKernel kernel) {
+    assert(kernel <= get_best_cull_kernel());
+    assert(first + count <= bounds.count);
+    const u32 last = first + count;
+#ifdef WCR_CULLING_X86
+    if (kernel == CullKernel::AVX2)
+        return frustum_cull_avx2(frustum, bounds, first, last, visibleIndices);
+    if (kernel == CullKernel::SSE)
+        return frustum_cull_sse(frustum, bounds, first, last, visibleIndices);
+#endif
+    return frustum_cull_scalar(frustum, bounds, first, last, visibleIndices);
+}
+
+void run_culling_benchmark(const u32 surfaceCount, const u32 iterations) {
+    // Boxes scattered through a Sponza sized volume around a camera looking down the long axis.
+    std::mt19937 rng(1337);
+    std::uniform_real_distribution position(-2000.0f, 2000.0f);
+    std::uniform_real_distribution size(1.0f, 100.0f);
+
+    SurfaceBounds bounds;
+    bounds.resize(surfaceCount);
+    for (u32 i = 0; i < surfaceCount; i++)
+        bounds.set(i, {position(rng), position(rng) * 0.25f, position(rng)}, {size(rng), size(rng), size(rng)});
+
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 10000.0f, 0.1f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 100.0f, 0.0f), glm::vec3(1.0f, 100.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const Frustum frustum = compute_frustum(projection * view);
+
+    std::vector<u32> visibleIndices(surfaceCount);
+    const u32 referenceCount = frustum_cull_bounds(frustum, bounds, 0, surfaceCount, visibleIndices.data(), CullKernel::Scalar);
+
+    std::println("Culling benchmark: {} surfaces, {} iterations, {} visible", surfaceCount, iterations, referenceCount);
+
+    for (const auto kernel : {CullKernel::Scalar, CullKernel::SSE, CullKernel::AVX2}) {
+        if (kernel > get_best_cull_kernel()) {
+            std::println("{:>8}: unsupported", get_cull_kernel_name(kernel));
+            continue;
+        }
+
+        u32 visibleCount = frustum_cull_bounds(frustum, bounds, 0, surfaceCount, visibleIndices.data(), kernel);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (u32 i = 0; i < iterations; i++)
+            visibleCount = frustum_cull_bounds(frustum, bounds, 0, surfaceCount, visibleIndices.data(), kernel);
+        const std::chrono::duration<f64> elapsed = std::chrono::steady_clock::now() - start;
+
+        const f64 surfacesPerSecond = static_cast<f64>(surfaceCount) * iterations / elapsed.count();
+        std::println("{:>8}: {:8.2f} M surfaces/s{}", get_cull_kernel_name(kernel), surfacesPerSecond / 1.0e6,
+            visibleCount != referenceCount ? " (visible count mismatch)" : "");
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "../common.h"
+#include "../glmdefines.h"
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+
+typedef glm::vec4 Plane;
+typedef std::array<Plane, 5> Frustum;
+
+static constexpr u32 CULL_BATCH_WIDTH = 8;
+
+enum class CullKernel : u8 {
+    Scalar, SSE, AVX2
+};
+
+// World space surface bounds stored as structure of arrays so a batch of surfaces can be tested per SIMD iteration.
+// Every array carries at least one batch of padding so a batch may start at any surface, padding lanes are never
+// reported as visible.
+struct SurfaceBounds {
+    std::vector<f32> centerX, centerY, centerZ;
+    std::vector<f32> extentX, extentY, extentZ;
+    u32 count{};
+
+    void resize(u32 surfaceCount);
+    void set(u32 index, const glm::vec3& center, const glm::vec3& extent);
+};
+
+Frustum compute_frustum(const glm::mat4& viewProjection);
+
+// Writes the indices of all surfaces in [first, first + count) that intersect the frustum into visibleIndices, which
+// must hold at least count entries, and returns how many were written. Indices are emitted in ascending order.
+u32 frustum_cull_bounds(const Frustum& frustum, const SurfaceBounds& bounds, u32* visibleIndices);
+u32 frustum_cull_bounds(const Frustum& frustum, const SurfaceBounds& bounds, u32 first, u32 count, u32* visibleIndices);
+u32 frustum_cull_bounds(const Frustum& frustum, const SurfaceBounds& bounds, u32 first, u32 count, u32* visibleIndices, CullKernel kernel);
+
+[[nodiscard]] CullKernel get_best_cull_kernel();
+[[nodiscard]] const char* get_cull_kernel_name(CullKernel kernel);
+
+void run_culling_benchmark(u32 surfaceCount, u32 iterations);
@@ -1,5 +1,13 @@
 
 #include "scenemanager.h"
+#include "cookedscene.h"
+
+#include <bit>
+#include <chrono>
+#include <numeric>
+
+#include <glm/gtc/packing.hpp>
+#include <meshoptimizer.h>
 
 Scene& SceneManager::get_scene(const SceneHandle handle) const {
     assert_handle(handle);
@@ -13,6 +21,27 @@ Node& SceneManager::get_node(const NodeHandle handle) const {
     return m_resourceData->nodes[index];
 }
 
+const glm::mat4& SceneManager::get_local_matrix(const NodeHandle handle) const {
+    assert_handle(handle);
+    return m_resourceData->nodeLocalMatrices[get_handle_index(handle)];
+}
+
+const glm::mat4& SceneManager::get_world_matrix(const NodeHandle handle) const {
+    assert_handle(handle);
+    return m_resourceData->nodeWorldMatrices[get_handle_index(handle)];
+}
+
+void SceneManager::set_local_matrix(const NodeHandle handle, const glm::mat4& localMatrix) {
+    assert_handle(handle);
+    const u32 index = get_handle_index(handle);
+    m_resourceData->nodeLocalMatrices[index] = localMatrix;
+    m_resourceData->nodeDirty[index] = true;
+
+    for (auto& scene : m_resourceData->scenes)
+        if (index >= scene.firstNode && index < scene.firstNode + scene.nodes.size())
+            scene.transformsDirty = true;
+}
+
 Light& SceneManager::get_light(const LightHandle handle) const {
     assert_handle(handle);
     const u32 index = get_handle_index(handle);
@@ -99,54 +128,567 @@ void SceneManager::assert_handle(const SamplerHandle handle) const {
     assert(m_resourceData->samplerMetadata[index] == metaData);
 }
 
-void SceneManager::draw_scene(const CommandBuffer &cmd, const SceneHandle handle, const glm::mat4 &viewProjectionMatrix) {
+void SceneManager::build_gpu_scene(const Context& context, const SceneHandle handle) {
+    const auto& scene = get_scene(handle);
+    m_gpuSurfaces.clear();
+    m_surfaceLods.clear();
+    m_surfaceIndexCount = 0;
+    m_triangleBatchCount = 0;
+
+    m_cullChunks.clear();
+
+    // Surfaces with 16 bit indices are stored first, so each index type is one contiguous range of the draw buffers
+    // drawn with its own index buffer bound. Chunks never span both ranges.
+    for (const auto indexType : {vk::IndexType::eUint16, vk::IndexType::eUint32}) {
+        for (const auto nodeHandle : scene.opaqueNodes) {
+            const auto& node = get_node(nodeHandle);
+            const auto& surfaces = get_mesh(node.mesh).surfaces;
+            const auto nodeSurfaceCount = static_cast<u32>(std::ranges::count(surfaces, indexType, &Surface::indexType));
+            if (nodeSurfaceCount == 0)
+                continue;
+
+            if (m_cullChunks.empty() || m_cullChunks.back().indexType != indexType || m_cullChunks.back().surfaceCount >= CULL_CHUNK_SURFACES)
+                m_cullChunks.push_back({static_cast<u32>(m_gpuSurfaces.size()), 0, indexType});
+            m_cullChunks.back().surfaceCount += nodeSurfaceCount;
+
+            for (const auto& surface : surfaces) {
+                if (surface.indexType != indexType)
+                    continue;
+
+                const auto& [min, max] = surface.boundingVolume;
+                GPUSurface gpuSurface;
+                gpuSurface.boundsCenter = glm::vec4((min + max) * 0.5f, 1.0f);
+                gpuSurface.boundsExtent = glm::vec4((max - min) * 0.5f, glm::length(max - min) * 0.5f);
+                gpuSurface.initialIndex = surface.initialIndex;
+                gpuSurface.indexCount = surface.indexCount;
+                gpuSurface.materialIndex = get_handle_index(surface.material);
+                gpuSurface.transformIndex = get_handle_index(nodeHandle);
+                gpuSurface.firstVertex = surface.firstVertex;
+                gpuSurface.packedOffset = surface.packedOffset;
+                gpuSurface.packedStride = surface.packedStride;
+                gpuSurface.firstMeshlet = surface.firstMeshlet;
+                gpuSurface.meshletCount = surface.meshletCount;
+                gpuSurface.doubleSided = surface.doubleSided;
+                gpuSurface.compactedIndex = static_cast<u32>(m_surfaceIndexCount);
+                gpuSurface.lodCount = surface.lodCount;
+                m_gpuSurfaces.push_back(gpuSurface);
+                m_surfaceLods.insert(m_surfaceLods.end(), surface.lods.begin(), surface.lods.end());
+
+                m_surfaceIndexCount += surface.indexCount;
+                m_triangleBatchCount += (surface.indexCount / 3 + TRIANGLE_BATCH_SIZE - 1) / TRIANGLE_BATCH_SIZE;
+            }
+        }
+
+        if (indexType == vk::IndexType::eUint16)
+            m_surfaceCount16 = static_cast<u32>(m_gpuSurfaces.size());
+    }
+
+    numSurfaces = m_gpuSurfaces.size();
+    m_cullBounds.resize(static_cast<u32>(numSurfaces));
+    m_visibleSurfaces.resize(numSurfaces);
+    m_chunkDrawCounts.resize(m_cullChunks.size());
+    m_chunkSmallCulledCounts.resize(m_cullChunks.size());
+
+    const u64 surfaceBufferSize = std::max<u64>(numSurfaces, 1) * sizeof(GPUSurface);
+    m_surfaceBuffer = context.create_buffer(
+        surfaceBufferSize,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+    );
+    memcpy(m_surfaceBuffer.p_get_mapped_data(), m_gpuSurfaces.data(), numSurfaces * sizeof(GPUSurface));
+
+    m_lodBuffer = context.create_buffer(
+        std::max<u64>(m_surfaceLods.size(), 1) * sizeof(SurfaceLod),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+    );
+    memcpy(m_lodBuffer.p_get_mapped_data(), m_surfaceLods.data(), m_surfaceLods.size() * sizeof(SurfaceLod));
+
+    const u64 transformBufferSize = std::max<u64>(m_resourceData->nodes.size(), 1) * sizeof(glm::mat4);
+    const u64 drawBufferSize = std::max<u64>(numSurfaces, 1) * sizeof(GPUDrawCommand);
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        m_transformBuffers[i] = context.create_buffer(
+            transformBufferSize,
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            VMA_MEMORY_USAGE_CPU_TO_GPU
+        );
+
+        m_drawBuffers[i] = context.create_buffer(
+            drawBufferSize,
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+            VMA_MEMORY_USAGE_CPU_TO_GPU
+        );
+
+        m_culledDrawBuffers[i] = context.create_buffer(
+            drawBufferSize,
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+            VMA_MEMORY_USAGE_GPU_ONLY
+        );
+
+        m_lateDrawBuffers[i] = context.create_buffer(
+            drawBufferSize,
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+            VMA_MEMORY_USAGE_GPU_ONLY
+        );
+
+        m_taskBuffers[i] = context.create_buffer(
+            2 * std::max<u64>(numSurfaces, 1) * sizeof(GPUTaskCommand),
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+            VMA_MEMORY_USAGE_GPU_ONLY
+        );
+
+        m_drawCountBuffers[i] = context.create_buffer(
+            DRAW_COUNT_SIZE * sizeof(u32),
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+            VMA_MEMORY_USAGE_GPU_TO_CPU
+        );
+
+        m_cullDataBuffers[i] = context.create_buffer(
+            sizeof(GPUCullData),
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            VMA_MEMORY_USAGE_CPU_TO_GPU
+        );
+
+        m_frameCullingModes[i] = m_cullingMode;
+        m_pendingTransforms[i].assign(1, {0, static_cast<u32>(m_resourceData->nodes.size())});
+    }
+
+    m_visibilityBuffer = context.create_buffer(
+        std::max<u64>(numSurfaces, 1) * sizeof(u32),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        VMA_MEMORY_USAGE_GPU_ONLY
+    );
+    m_resetVisibility = true;
+
+    // The previous scene's buffers are gone, see release_gpu_resources().
+    m_compactedIndexBuffers = {};
+    m_triangleBatchBuffers = {};
+    set_triangle_culling(context, m_triangleCulling);
+}
+
+void SceneManager::set_triangle_culling(const Context& context, const bool enabled) {
+    m_triangleCulling = enabled;
+    // Without a GPU scene the buffers are created by build_gpu_scene().
+    if (!enabled || m_surfaceBuffer.handle == VK_NULL_HANDLE || m_compactedIndexBuffers[0].handle != VK_NULL_HANDLE)
+        return;
+
+    // Every batch is one workgroup of a single indirect dispatch.
+    if (m_triangleBatchCount > context.get_device().get_max_compute_group_count_x()) {
+        std::println("Triangle culling disabled, {} triangle batches exceed the dispatch limit", m_triangleBatchCount);
+        m_triangleCulling = false;
+        return;
+    }
+
+    create_triangle_culling_buffers(context);
+}
+
+void SceneManager::set_lod_view(const glm::vec3& cameraPosition, const glm::mat4& projection, const f32 viewportHeight) {
+    m_lodView.cameraPosition = cameraPosition;
+    m_lodView.pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+}
+
+// Picks the coarsest LOD whose error, scaled to pixels at the point of the bounding sphere nearest to the camera,
+// stays within the threshold. The cull shader's select_lod() makes the same choice.
+u32 SceneManager::select_lod(const u32 surfaceIndex, const BoundingSphere& worldSphere, const f32 worldScale) const {
+    const f32 distance = std::max(glm::length(glm::vec3(worldSphere.center) - m_lodView.cameraPosition) - worldSphere.radius, 0.0f);
+    const f32 pixelsPerError = worldScale * m_lodView.pixelsPerUnit;
+    const SurfaceLod* lods = m_surfaceLods.data() + surfaceIndex * MAX_SURFACE_LODS;
+
+    u32 lod = 0;
+    while (lod + 1 < m_gpuSurfaces[surfaceIndex].lodCount && lods[lod + 1].error * pixelsPerError <= m_lodView.errorThreshold * distance)
+        lod++;
+    return lod;
+}
+
+// Whether the bounding sphere's diameter, scaled to pixels at its point nearest to the camera like select_lod() does,
+// is below the minimum. That distance overestimates the projected size, so borderline surfaces are kept. The cull
+// shader's below_min_projected_size() makes the same choice.
+bool SceneManager::below_min_projected_size(const BoundingSphere& worldSphere) const {
+    const f32 distance = std::max(glm::length(glm::vec3(worldSphere.center) - m_lodView.cameraPosition) - worldSphere.radius, 0.0f);
+    return 2.0f * worldSphere.radius * m_lodView.pixelsPerUnit < m_lodView.minProjectedSize * distance;
+}
+
+void SceneManager::create_triangle_culling_buffers(const Context& context) {
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        m_compactedIndexBuffers[i] = context.create_buffer(
+            std::max<u64>(m_surfaceIndexCount, 1) * sizeof(u32),
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndexBuffer,
+            VMA_MEMORY_USAGE_GPU_ONLY
+        );
+
+        m_triangleBatchBuffers[i] = context.create_buffer(
+            2 * std::max<u64>(m_triangleBatchCount, 1) * sizeof(GPUTriangleBatch),
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            VMA_MEMORY_USAGE_GPU_ONLY
+        );
+    }
+}
+
+void SceneManager::cull_scene(
+    CommandBuffer &cmd,
+    const SceneHandle handle,
+    const glm::mat4 &viewProjectionMatrix,
+    const u32 frameIndex,
+    const Pipeline &cullPipeline,
+    const glm::vec2 &depthPyramidSize,
+    const glm::vec2 &viewportSize)
+{
+    assert_handle(handle);
+    upload_transforms(frameIndex);
+
+    // The fence for this frame has already been waited on, so the counts hold the result of the last
+    // submission that used this frame's buffers.
+    const auto* gpuDrawCounts = static_cast<u32*>(m_drawCountBuffers[frameIndex].p_get_mapped_data());
+    const u32 earlyDraws = gpuDrawCounts[DRAW_COUNT_EARLY] + gpuDrawCounts[DRAW_COUNT_EARLY + 1];
+    const u32 lateDraws = gpuDrawCounts[DRAW_COUNT_LATE] + gpuDrawCounts[DRAW_COUNT_LATE + 1];
+    if (m_frameCullingModes[frameIndex] == CullingMode::Validation && earlyDraws != m_cpuDrawCounts[frameIndex])
+        m_cullingStats.validationMismatches++;
+
+    m_cullingStats.totalDraws = static_cast<u32>(numSurfaces);
+    m_cullingStats.gpuVisibleDraws = earlyDraws + lateDraws;
+    m_cullingStats.lateVisibleDraws = lateDraws;
+    m_cullingStats.testedTriangles = gpuDrawCounts[DRAW_COUNT_TRIANGLES];
+    m_cullingStats.keptTriangles = gpuDrawCounts[DRAW_COUNT_TRIANGLES + 1];
+    m_cullingStats.lodTriangles = gpuDrawCounts[DRAW_COUNT_LOD_TRIANGLES];
+    m_cullingStats.fullDetailTriangles = gpuDrawCounts[DRAW_COUNT_LOD_TRIANGLES + 1];
+    m_cullingStats.gpuSmallCulledDraws = gpuDrawCounts[DRAW_COUNT_SMALL_CULLED];
+    m_frameCullingModes[frameIndex] = m_cullingMode;
+
+    // CPU mode culls while recording in record_scene, validation only needs the CPU count to compare against.
+    if (m_cullingMode == CullingMode::CPU)
+        return;
+
+    if (m_cullingMode == CullingMode::Validation) {
+        auto* drawCommands = static_cast<GPUDrawCommand*>(m_drawBuffers[frameIndex].p_get_mapped_data());
+        m_cpuDrawCounts[frameIndex] = cpu_frustum_culling(viewProjectionMatrix, drawCommands);
+        m_cullingStats.cpuVisibleDraws = m_cpuDrawCounts[frameIndex];
+        m_cullingStats.cpuSmallCulledDraws = std::accumulate(m_chunkSmallCulledCounts.begin(), m_chunkSmallCulledCounts.end(), 0u);
+    }
+
+    auto* cullData = static_cast<GPUCullData*>(m_cullDataBuffers[frameIndex].p_get_mapped_data());
+    cullData->viewProjection = viewProjectionMatrix;
+    cullData->frustum = compute_frustum(viewProjectionMatrix);
+    cullData->depthPyramidSize = depthPyramidSize;
+    cullData->surfaceCount = static_cast<u32>(numSurfaces);
+    cullData->surfaceCount16 = m_surfaceCount16;
+    cullData->viewportSize = viewportSize;
+    cullData->pixelsPerUnit = m_lodView.pixelsPerUnit;
+    cullData->lodErrorThreshold = m_lodView.errorThreshold;
+    cullData->cameraPosition = m_lodView.cameraPosition;
+    cullData->minProjectedSize = m_lodView.minProjectedSize;
+
+    // Zeroed dispatches launch nothing, the cull shader only fills in y and z when it queues a batch.
+    const auto& countBuffer = m_drawCountBuffers[frameIndex];
+    cmd.fill_buffer(countBuffer, 0, DRAW_COUNT_SIZE * sizeof(u32), 0);
+
+    // Nothing was drawn in the early pass the first time round, so the late pass starts with an empty visible set.
+    const bool occlusion = occlusion_culling_active();
+
+    // Every frame in flight shares the visibility buffer, the previous frame's late cull writes what this frame's
+    // early cull reads or the reset overwrites.
+    if (occlusion)
+        cmd.memory_barrier(
+            vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+            vk::PipelineStageFlagBits2::eTransfer | vk::PipelineStageFlagBits2::eComputeShader,
+            vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite
+        );
+
+    if (occlusion && m_resetVisibility) {
+        cmd.fill_buffer(m_visibilityBuffer, 0, numSurfaces * sizeof(u32), 0);
+        m_resetVisibility = false;
+    }
+
+    cmd.memory_barrier(
+        vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+        vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite
+    );
+
+    cmd.bind_pipeline(vk::PipelineBindPoint::eCompute, cullPipeline);
+    gpu_culling(cmd, frameIndex, occlusion ? CullPhase::Early : CullPhase::Frustum);
+}
+
+void SceneManager::cull_occluded(CommandBuffer &cmd, const u32 frameIndex, const Pipeline &cullPipeline) {
+    assert(occlusion_culling_active());
+    cmd.bind_pipeline(vk::PipelineBindPoint::eCompute, cullPipeline);
+    gpu_culling(cmd, frameIndex, CullPhase::Late);
+}
+
+void SceneManager::cull_triangles(CommandBuffer &cmd, const u32 frameIndex, const Pipeline &triangleCullPipeline, const CullPhase phase) {
+    assert(triangle_culling_active());
+    const bool late = phase == CullPhase::Late;
+    const auto& countBuffer = m_drawCountBuffers[frameIndex];
+
+    TriangleCullPushConstants trianglePc{};
+    trianglePc.surfaceBuffer = m_surfaceBuffer.deviceAddress;
+    trianglePc.transformBuffer = m_transformBuffers[frameIndex].deviceAddress;
+    trianglePc.positionBuffer = m_resourceData->positionBuffer.deviceAddress;
+    trianglePc.indexBuffer = m_resourceData->indexBuffer.deviceAddress;
+    trianglePc.indexBuffer16 = m_resourceData->indexBuffer16.deviceAddress;
+    trianglePc.drawBuffer = late ? m_lateDrawBuffers[frameIndex].deviceAddress : m_culledDrawBuffers[frameIndex].deviceAddress;
+    trianglePc.triangleBatchBuffer = m_triangleBatchBuffers[frameIndex].deviceAddress + (late ? m_triangleBatchCount * sizeof(GPUTriangleBatch) : 0);
+    trianglePc.compactedIndexBuffer = m_compactedIndexBuffers[frameIndex].deviceAddress;
+    trianglePc.cullDataBuffer = m_cullDataBuffers[frameIndex].deviceAddress;
+    trianglePc.triangleCountBuffer = countBuffer.deviceAddress + DRAW_COUNT_TRIANGLES * sizeof(u32);
+    trianglePc.vertexFormat = m_resourceData->vertexFormat;
+
+    cmd.bind_pipeline(vk::PipelineBindPoint::eCompute, triangleCullPipeline);
+    cmd.set_push_constants(&trianglePc, sizeof(trianglePc), vk::ShaderStageFlagBits::eCompute);
+    cmd.dispatch_indirect(countBuffer, (late ? DRAW_COUNT_LATE_DISPATCH : DRAW_COUNT_EARLY_DISPATCH) * sizeof(u32));
+
+    cmd.memory_barrier(
+        vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+        vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eIndexInput | vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eHost,
+        vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eIndexRead | vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eHostRead
+    );
+}
+
+void SceneManager::record_scene(const DrawRecordInfo &recordInfo, const glm::mat4 &viewProjectionMatrix, const u32 frameIndex) {
+    assert(records_secondary_commands());
+    assert(recordInfo.workerCommandBuffers.size() >= m_jobSystem.get_worker_count());
+
+    const auto& drawBuffer = m_drawBuffers[frameIndex];
+    auto* drawCommands = static_cast<GPUDrawCommand*>(drawBuffer.p_get_mapped_data());
+    const Frustum frustum = compute_frustum(viewProjectionMatrix);
+    update_push_constants(frameIndex, drawBuffer);
+
+    // Workers begin their secondary command buffer the first time they pick up a chunk, so only the buffers of
+    // workers that actually ran are executed.
+    std::vector<u8> workerRecording(recordInfo.workerCommandBuffers.size(), false);
+
+    m_jobSystem.parallel_for(static_cast<u32>(m_cullChunks.size()), [&](const u32 chunkIndex, const u32 workerIndex) {
+        const u32 drawCount = cull_chunk(frustum, chunkIndex, drawCommands);
+        m_chunkDrawCounts[chunkIndex] = drawCount;
+
+        auto& workerCmd = recordInfo.workerCommandBuffers[workerIndex];
+        if (!workerRecording[workerIndex]) {
+            workerCmd.begin_secondary(recordInfo.colorFormat, recordInfo.depthFormat);
+            workerCmd.bind_pipeline(vk::PipelineBindPoint::eGraphics, *recordInfo.pipeline);
+            workerCmd.set_viewport(recordInfo.extent, 0.0f, 1.0f);
+            workerCmd.set_scissor(recordInfo.extent);
+            workerRecording[workerIndex] = true;
+        }
+
+        if (drawCount == 0)
+            return;
+
+        const auto& chunk = m_cullChunks[chunkIndex];
+        const bool indices16 = chunk.indexType == vk::IndexType::eUint16;
+        workerCmd.bind_index_buffer(indices16 ? m_resourceData->indexBuffer16 : m_resourceData->indexBuffer, chunk.indexType);
+
+        // Draw indices restart with every indirect draw, so each chunk points the shaders at its own commands.
+        const u64 drawOffset = chunk.firstSurface * sizeof(GPUDrawCommand);
+        PushConstants chunkPc = pc;
+        chunkPc.drawBuffer += drawOffset;
+        workerCmd.set_push_constants(&chunkPc, sizeof(chunkPc), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
+        workerCmd.draw_indexed_indirect(drawBuffer, drawOffset, drawCount, sizeof(GPUDrawCommand));
+    });
+
+    m_recordedCommandBuffers.clear();
+    for (u32 i = 0; i < workerRecording.size(); i++) {
+        if (!workerRecording[i])
+            continue;
+        recordInfo.workerCommandBuffers[i].end();
+        m_recordedCommandBuffers.push_back(recordInfo.workerCommandBuffers[i].get_handle());
+    }
+
+    m_cpuDrawCounts[frameIndex] = std::accumulate(m_chunkDrawCounts.begin(), m_chunkDrawCounts.end(), 0u);
+    m_cullingStats.cpuVisibleDraws = m_cpuDrawCounts[frameIndex];
+    m_cullingStats.cpuSmallCulledDraws = std::accumulate(m_chunkSmallCulledCounts.begin(), m_chunkSmallCulledCounts.end(), 0u);
+}
+
+void SceneManager::draw_scene(const CommandBuffer &cmd, const u32 frameIndex, const CullPhase phase) {
+    if (records_secondary_commands()) {
+        cmd.execute_commands(m_recordedCommandBuffers);
+        return;
+    }
+
+    if (mesh_shading_active()) {
+        draw_meshlets(cmd, frameIndex, phase);
+        return;
+    }
+
+    const bool late = phase == CullPhase::Late;
+    const auto& drawBuffer = late ? m_lateDrawBuffers[frameIndex] : m_culledDrawBuffers[frameIndex];
+
+    const auto& countBuffer = m_drawCountBuffers[frameIndex];
+    const u64 countOffset = (late ? DRAW_COUNT_LATE : DRAW_COUNT_EARLY) * sizeof(u32);
+    const u32 surfaceCount32 = static_cast<u32>(numSurfaces) - m_surfaceCount16;
+    update_push_constants(frameIndex, drawBuffer);
+
+    // Triangle culling compacts both index types into one 32 bit buffer, the draws keep their two ranges.
+    const bool compacted = triangle_culling_active();
+
+    // One draw per index type over its own range of the draw buffer, with its own count.
+    if (m_surfaceCount16 > 0) {
+        if (compacted)
+            cmd.bind_index_buffer(m_compactedIndexBuffers[frameIndex], vk::IndexType::eUint32);
+        else
+            cmd.bind_index_buffer(m_resourceData->indexBuffer16, vk::IndexType::eUint16);
+        cmd.set_push_constants(&pc, sizeof(pc), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
+        cmd.draw_indexed_indirect_count(
+            drawBuffer, 0,
+            countBuffer, countOffset,
+            m_surfaceCount16, sizeof(GPUDrawCommand));
+    }
+
+    if (surfaceCount32 > 0) {
+        // Draw indices restart with every indirect draw, so the shaders are pointed at the 32 bit range.
+        const u64 drawOffset = m_surfaceCount16 * sizeof(GPUDrawCommand);
+        PushConstants drawPc = pc;
+        drawPc.drawBuffer += drawOffset;
+        cmd.bind_index_buffer(compacted ? m_compactedIndexBuffers[frameIndex] : m_resourceData->indexBuffer, vk::IndexType::eUint32);
+        cmd.set_push_constants(&drawPc, sizeof(drawPc), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
+        cmd.draw_indexed_indirect_count(
+            drawBuffer, drawOffset,
+            countBuffer, countOffset + sizeof(u32),
+            surfaceCount32, sizeof(GPUDrawCommand));
+    }
+}
+
+void SceneManager::draw_meshlets(const CommandBuffer &cmd, const u32 frameIndex, const CullPhase phase) {
+    const bool late = phase == CullPhase::Late;
+    const auto& taskBuffer = m_taskBuffers[frameIndex];
+    const u64 taskOffset = late ? numSurfaces * sizeof(GPUTaskCommand) : 0;
+
+    const auto& countBuffer = m_drawCountBuffers[frameIndex];
+    const u64 countOffset = (late ? DRAW_COUNT_LATE : DRAW_COUNT_EARLY) * sizeof(u32);
+    const u32 surfaceCount32 = static_cast<u32>(numSurfaces) - m_surfaceCount16;
+    update_push_constants(frameIndex, late ? m_lateDrawBuffers[frameIndex] : m_culledDrawBuffers[frameIndex]);
+
+    // Meshlets ignore the index buffers, but the cull shader still compacts each index type into its own range and
+    // count, so the ranges are drawn one after the other.
+    const std::array<std::pair<u32, u32>, 2> ranges{{{0, m_surfaceCount16}, {m_surfaceCount16, surfaceCount32}}};
+    for (u32 i = 0; i < ranges.size(); i++) {
+        const auto [firstSurface, surfaceCount] = ranges[i];
+        if (surfaceCount == 0)
+            continue;
+
+        const u64 rangeOffset = taskOffset + firstSurface * sizeof(GPUTaskCommand);
+        PushConstants drawPc = pc;
+        drawPc.taskBuffer += rangeOffset;
+        cmd.set_push_constants(&drawPc, sizeof(drawPc),
+            vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT | vk::ShaderStageFlagBits::eFragment);
+        cmd.draw_mesh_tasks_indirect_count(
+            taskBuffer, rangeOffset,
+            countBuffer, countOffset + i * sizeof(u32),
+            surfaceCount, sizeof(GPUTaskCommand));
+    }
+}
+
+void SceneManager::update_push_constants(const u32 frameIndex, const Buffer &drawBuffer) {
     pc.vertexBuffer = m_resourceData->vertexBuffer.deviceAddress;
+    pc.positionBuffer = m_resourceData->positionBuffer.deviceAddress;
     pc.materialBuffer = m_resourceData->materialBuffer.deviceAddress;
     pc.lightBuffer = m_resourceData->lightBuffer.deviceAddress;
+    pc.surfaceBuffer = m_surfaceBuffer.deviceAddress;
+    pc.transformBuffer = m_transformBuffers[frameIndex].deviceAddress;
+    pc.drawBuffer = drawBuffer.deviceAddress;
     pc.numLights = static_cast<u32>(m_resourceData->lights.size());
+    pc.vertexFormat = m_resourceData->vertexFormat;
+    pc.taskBuffer = m_taskBuffers[frameIndex].deviceAddress;
+    pc.meshletBuffer = m_resourceData->meshletBuffer.deviceAddress;
+    pc.meshletDataBuffer = m_resourceData->meshletDataBuffer.deviceAddress;
+    pc.cullDataBuffer = m_cullDataBuffers[frameIndex].deviceAddress;
+    pc.lodTriangleBuffer = m_drawCountBuffers[frameIndex].deviceAddress + DRAW_COUNT_LOD_TRIANGLES * sizeof(u32);
+}
 
-    const auto scene = get_scene(handle);
-    cmd.bind_index_buffer(m_resourceData->indexBuffer);
-    cpu_frustum_culling(scene, viewProjectionMatrix);
+u32 SceneManager::cpu_frustum_culling(const glm::mat4 &viewProjectionMatrix, GPUDrawCommand* drawCommands) {
+    const Frustum frustum = compute_frustum(viewProjectionMatrix);
+    m_jobSystem.parallel_for(static_cast<u32>(m_cullChunks.size()), [&](const u32 chunkIndex, u32) {
+        m_chunkDrawCounts[chunkIndex] = cull_chunk(frustum, chunkIndex, drawCommands);
+    });
 
+    return std::accumulate(m_chunkDrawCounts.begin(), m_chunkDrawCounts.end(), 0u);
+}
 
-    for (const auto&[surface, worldMatrix] : m_renderables) {
-        pc.renderMatrix = worldMatrix;
-        pc.materialIndex = get_handle_index(surface.material);
-        cmd.set_push_constants(&pc, sizeof(pc), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
-        cmd.draw(surface.indexCount, surface.initialIndex);
-    }
-
-    m_renderables.clear();
-}
-
-void SceneManager::cpu_frustum_culling(const Scene& scene, const glm::mat4 &viewProjectionMatrix) {
-    const Frustum viewFrustum = compute_frustum(viewProjectionMatrix);
-
-    for (const auto& NodeHandle : scene.opaqueNodes) {
-        const auto& node = get_node(NodeHandle);
-        auto& mesh = get_mesh(node.mesh);
-
-        for (auto& surface : mesh.surfaces) {
-            AABB transformedAABB = recompute_aabb(surface.boundingVolume, node.worldMatrix);
-            const auto [min, max] = transformedAABB;
-            bool visible = true;
-            for (const auto& plane : viewFrustum) {
-                int out = 0;
-                out += dot(plane, glm::vec4(min.x, min.y, min.z, 1.0f)) < 0.0f ? 1.0f : 0.0f;
-                out += dot(plane, glm::vec4(max.x, min.y, min.z, 1.0f)) < 0.0f ? 1.0f : 0.0f;
-                out += dot(plane, glm::vec4(min.x, max.y, min.z, 1.0f)) < 0.0f ? 1.0f : 0.0f;
-                out += dot(plane, glm::vec4(max.x, max.y, min.z, 1.0f)) < 0.0f ? 1.0f : 0.0f;
-                out += dot(plane, glm::vec4(min.x, min.y, max.z, 1.0f)) < 0.0f ? 1.0f : 0.0f;
-                out += dot(plane, glm::vec4(max.x, min.y, max.z, 1.0f)) < 0.0f ? 1.0f : 0.0f;
-                out += dot(plane, glm::vec4(min.x, max.y, max.z, 1.0f)) < 0.0f ? 1.0f : 0.0f;
-                out += dot(plane, glm::vec4(max.x, max.y, max.z, 1.0f)) < 0.0f ? 1.0f : 0.0f;
-                if (out == 8) visible = false;
-            }
+// Culls one chunk and writes its visible draws to the start of the chunk's own region of drawCommands, so chunks
+// never share output and can run on any thread. Surfaces in the frustum that project below the minimum size are
+// dropped and counted in the chunk's small culled count.
+u32 SceneManager::cull_chunk(const Frustum &frustum, const u32 chunkIndex, GPUDrawCommand* drawCommands) {
+    const auto& worldMatrices = m_resourceData->nodeWorldMatrices;
+    const auto [firstSurface, surfaceCount] = m_cullChunks[chunkIndex];
+
+    for (u32 i = firstSurface; i < firstSurface + surfaceCount; i++) {
+        const auto& surface = m_gpuSurfaces[i];
+        const glm::mat4& worldMatrix = worldMatrices[surface.transformIndex];
+        const glm::mat3 absMatrix(
+            glm::abs(glm::vec3(worldMatrix[0])),
+            glm::abs(glm::vec3(worldMatrix[1])),
+            glm::abs(glm::vec3(worldMatrix[2])));
+
+        m_cullBounds.set(i, glm::vec3(worldMatrix * surface.boundsCenter), absMatrix * glm::vec3(surface.boundsExtent));
+    }
 
-            if (visible) m_renderables.push_back({surface, node.worldMatrix});
-        }
+    u32* visibleSurfaces = m_visibleSurfaces.data() + firstSurface;
+    const u32 visibleCount = frustum_cull_bounds(frustum, m_cullBounds, firstSurface, surfaceCount, visibleSurfaces);
+
+    u32 drawCount = 0;
+    for (u32 i = 0; i < visibleCount; i++) {
+        const u32 surfaceIndex = visibleSurfaces[i];
+        const auto& surface = m_gpuSurfaces[surfaceIndex];
+
+        const glm::mat4& worldMatrix = worldMatrices[surface.transformIndex];
+        const f32 worldScale = std::sqrt(std::max({
+            glm::dot(glm::vec3(worldMatrix[0]), glm::vec3(worldMatrix[0])),
+            glm::dot(glm::vec3(worldMatrix[1]), glm::vec3(worldMatrix[1])),
+            glm::dot(glm::vec3(worldMatrix[2]), glm::vec3(worldMatrix[2]))}));
+        const BoundingSphere sphere{worldMatrix * surface.boundsCenter, surface.boundsExtent.w * worldScale};
+        if (below_min_projected_size(sphere))
+            continue;
+
+        const auto& lod = m_surfaceLods[surfaceIndex * MAX_SURFACE_LODS + select_lod(surfaceIndex, sphere, worldScale)];
+
+        GPUDrawCommand& draw = drawCommands[firstSurface + drawCount++];
+        draw.command.indexCount = lod.indexCount;
+        draw.command.instanceCount = 1;
+        draw.command.firstIndex = lod.initialIndex;
+        draw.command.vertexOffset = static_cast<i32>(surface.firstVertex);
+        draw.command.firstInstance = surfaceIndex;
+        draw.surfaceIndex = surfaceIndex;
     }
+
+    m_chunkSmallCulledCounts[chunkIndex] = visibleCount - drawCount;
+    return drawCount;
+}
+
+void SceneManager::gpu_culling(const CommandBuffer &cmd, const u32 frameIndex, const CullPhase phase) {
+    const bool late = phase == CullPhase::Late;
+
+    cullPc.surfaceBuffer = m_surfaceBuffer.deviceAddress;
+    cullPc.transformBuffer = m_transformBuffers[frameIndex].deviceAddress;
+    cullPc.drawBuffer = late ? m_lateDrawBuffers[frameIndex].deviceAddress : m_culledDrawBuffers[frameIndex].deviceAddress;
+    cullPc.drawCountBuffer = m_drawCountBuffers[frameIndex].deviceAddress + (late ? DRAW_COUNT_LATE : DRAW_COUNT_EARLY) * sizeof(u32);
+    cullPc.cullDataBuffer = m_cullDataBuffers[frameIndex].deviceAddress;
+    cullPc.visibilityBuffer = m_visibilityBuffer.deviceAddress;
+    cullPc.taskBuffer = m_taskBuffers[frameIndex].deviceAddress + (late ? numSurfaces * sizeof(GPUTaskCommand) : 0);
+    cullPc.triangleBatchBuffer = m_triangleBatchBuffers[frameIndex].deviceAddress + (late ? m_triangleBatchCount * sizeof(GPUTriangleBatch) : 0);
+    cullPc.triangleDispatchBuffer = m_drawCountBuffers[frameIndex].deviceAddress + (late ? DRAW_COUNT_LATE_DISPATCH : DRAW_COUNT_EARLY_DISPATCH) * sizeof(u32);
+    cullPc.lodBuffer = m_lodBuffer.deviceAddress;
+    cullPc.lodTriangleBuffer = m_drawCountBuffers[frameIndex].deviceAddress + DRAW_COUNT_LOD_TRIANGLES * sizeof(u32);
+    cullPc.smallCulledBuffer = m_drawCountBuffers[frameIndex].deviceAddress + DRAW_COUNT_SMALL_CULLED * sizeof(u32);
+    cullPc.phase = phase;
+    cullPc.taskDraws = mesh_shading_active();
+    cullPc.triangleCulling = triangle_culling_active();
+
+    cmd.set_push_constants(&cullPc, sizeof(cullPc), vk::ShaderStageFlagBits::eCompute);
+    cmd.dispatch((static_cast<u32>(numSurfaces) + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    // Task stages are only valid on devices with mesh shading enabled. Triangle culling reads the draws and batches
+    // in the next dispatch, both it and the task shader add to the counts.
+    const auto drawStages = mesh_shading_active() ? vk::PipelineStageFlagBits2::eTaskShaderEXT : vk::PipelineStageFlagBits2::eVertexShader;
+    cmd.memory_barrier(
+        vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+        vk::PipelineStageFlagBits2::eDrawIndirect | drawStages | vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eHost,
+        vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eHostRead
+    );
+}
+
+void SceneManager::upload_transforms(const u32 frameIndex) {
+    const auto& worldMatrices = m_resourceData->nodeWorldMatrices;
+    auto* transforms = static_cast<glm::mat4*>(m_transformBuffers[frameIndex].p_get_mapped_data());
+    for (const auto& [firstNode, count] : m_pendingTransforms[frameIndex])
+        memcpy(transforms + firstNode, worldMatrices.data() + firstNode, count * sizeof(glm::mat4));
+    m_pendingTransforms[frameIndex].clear();
 }
 
 void SceneManager::update_light_buffer(const CommandBuffer& cmd) const {
@@ -162,11 +704,53 @@ void SceneManager::update_light_buffer(const CommandBuffer& cmd) const {
     }
 }
 
-void SceneManager::update_nodes(const glm::mat4 &rootMatrix, const SceneHandle handle) {
-    for (const auto& scene = get_scene(handle); const auto nodeHandle : scene.nodes) {
-        auto& node = get_node(nodeHandle);
-        node.refresh(rootMatrix, *this);
+u32 SceneManager::update_nodes(const glm::mat4 &rootMatrix, const SceneHandle handle) {
+    auto& scene = get_scene(handle);
+    const auto& localMatrices = m_resourceData->nodeLocalMatrices;
+    const auto& parents = m_resourceData->nodeParents;
+    auto& worldMatrices = m_resourceData->nodeWorldMatrices;
+    auto& dirty = m_resourceData->nodeDirty;
+    const u64 lastNode = scene.firstNode + scene.nodes.size();
+
+    m_changedTransforms.clear();
+    if (rootMatrix != scene.rootMatrix) {
+        scene.rootMatrix = rootMatrix;
+        scene.transformsDirty = true;
+        for (u64 i = scene.firstNode; i < lastNode; i++)
+            if (parents[i] == NO_PARENT)
+                dirty[i] = true;
+    }
+    if (!scene.transformsDirty)
+        return 0;
+
+    // Parents precede their children, so a parent's dirty flag and world matrix are final by the time a child
+    // reads them. Dirtiness spreads down the subtree in the same pass.
+    u32 changedCount = 0;
+    for (u64 i = scene.firstNode; i < lastNode; i++) {
+        const u32 parent = parents[i];
+        if (parent != NO_PARENT)
+            dirty[i] |= dirty[parent];
+        if (!dirty[i])
+            continue;
+
+        worldMatrices[i] = (parent == NO_PARENT ? rootMatrix : worldMatrices[parent]) * localMatrices[i];
+        changedCount++;
+
+        const u32 index = static_cast<u32>(i);
+        if (!m_changedTransforms.empty() && m_changedTransforms.back().firstNode + m_changedTransforms.back().count == index)
+            m_changedTransforms.back().count++;
+        else
+            m_changedTransforms.push_back({index, 1});
     }
+
+    // Flags are cleared afterwards since children test their parent's flag during the pass.
+    for (const auto& [firstNode, count] : m_changedTransforms)
+        std::fill_n(dirty.begin() + firstNode, count, 0);
+    for (auto& pending : m_pendingTransforms)
+        pending.insert(pending.end(), m_changedTransforms.begin(), m_changedTransforms.end());
+    scene.transformsDirty = false;
+
+    return changedCount;
 }
 
 void SceneManager::release_gpu_resources(const Context& context) const {
@@ -177,7 +761,26 @@ void SceneManager::release_gpu_resources(const Context& context) const {
     vmaDestroyBuffer(allocator, m_resourceData->materialBuffer.handle, m_resourceData->materialBuffer.allocation);
 
     vmaDestroyBuffer(allocator, m_resourceData->vertexBuffer.handle, m_resourceData->vertexBuffer.allocation);
+    vmaDestroyBuffer(allocator, m_resourceData->positionBuffer.handle, m_resourceData->positionBuffer.allocation);
     vmaDestroyBuffer(allocator, m_resourceData->indexBuffer.handle, m_resourceData->indexBuffer.allocation);
+    vmaDestroyBuffer(allocator, m_resourceData->indexBuffer16.handle, m_resourceData->indexBuffer16.allocation);
+    vmaDestroyBuffer(allocator, m_resourceData->meshletBuffer.handle, m_resourceData->meshletBuffer.allocation);
+    vmaDestroyBuffer(allocator, m_resourceData->meshletDataBuffer.handle, m_resourceData->meshletDataBuffer.allocation);
+
+    vmaDestroyBuffer(allocator, m_surfaceBuffer.handle, m_surfaceBuffer.allocation);
+    vmaDestroyBuffer(allocator, m_lodBuffer.handle, m_lodBuffer.allocation);
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vmaDestroyBuffer(allocator, m_transformBuffers[i].handle, m_transformBuffers[i].allocation);
+        vmaDestroyBuffer(allocator, m_drawBuffers[i].handle, m_drawBuffers[i].allocation);
+        vmaDestroyBuffer(allocator, m_culledDrawBuffers[i].handle, m_culledDrawBuffers[i].allocation);
+        vmaDestroyBuffer(allocator, m_lateDrawBuffers[i].handle, m_lateDrawBuffers[i].allocation);
+        vmaDestroyBuffer(allocator, m_taskBuffers[i].handle, m_taskBuffers[i].allocation);
+        vmaDestroyBuffer(allocator, m_compactedIndexBuffers[i].handle, m_compactedIndexBuffers[i].allocation);
+        vmaDestroyBuffer(allocator, m_triangleBatchBuffers[i].handle, m_triangleBatchBuffers[i].allocation);
+        vmaDestroyBuffer(allocator, m_drawCountBuffers[i].handle, m_drawCountBuffers[i].allocation);
+        vmaDestroyBuffer(allocator, m_cullDataBuffers[i].handle, m_cullDataBuffers[i].allocation);
+    }
+    vmaDestroyBuffer(allocator, m_visibilityBuffer.handle, m_visibilityBuffer.allocation);
 
     for (auto& texture : m_resourceData->textures) {
         vmaDestroyImage(allocator, texture.handle, texture.allocation);
@@ -189,16 +792,13 @@ void SceneManager::release_gpu_resources(const Context& context) const {
     }
 }
 
-Frustum compute_frustum(const glm::mat4 &viewProjection) {
-    const glm::mat4 transpose = glm::transpose(viewProjection);
-
-    const Plane leftPlane = transpose[3] + transpose[0];
-    const Plane rightPlane = transpose[3] - transpose[0];
-    const Plane bottomPlane = transpose[3] + transpose[1];
-    const Plane topPlane = transpose[3] - transpose[1];
-    const Plane nearPlane = transpose[3] + transpose[2];
-
-    return {leftPlane, rightPlane, bottomPlane, topPlane, nearPlane};
+void SceneManager::write_textures(DescriptorBuilder &builder) const {
+    u32 i = 0;
+    for (const auto& texture : m_resourceData->textures) {
+        const auto sampler = m_resourceData->samplers[0];
+        builder.write_image(i, texture.view, sampler.sampler, vk::ImageLayout::eShaderReadOnlyOptimal, vk::DescriptorType::eCombinedImageSampler);
+        i++;
+    }
 }
 
 AABB recompute_aabb(const AABB &oldAABB, const glm::mat4 &transform) {
@@ -227,18 +827,45 @@ AABB recompute_aabb(const AABB &oldAABB, const glm::mat4 &transform) {
     return result;
 }
 
-void Node::refresh(const glm::mat4& parentMatrix, SceneManager& sceneManager) {
-    worldMatrix = parentMatrix * localMatrix;
-    for (const auto childHandle : children)
-        sceneManager.get_node(childHandle).refresh(worldMatrix, sceneManager);
+SceneBuilder::SceneBuilder(Context &context, JobSystem& jobSystem, const SceneImportOptions& importOptions)
+    : m_context(context), m_jobSystem(jobSystem), m_stagingRing(std::make_unique<StagingRing>(context)), m_importOptions(importOptions) {
 }
 
-SceneBuilder::SceneBuilder(Context &context, const std::shared_ptr<ResourceData>& resourceData)  : m_context(context) {
-    m_resourceData = resourceData;
+LoadedScene SceneBuilder::load_scene(const std::filesystem::path& path) {
+    std::scoped_lock lock(m_loadMutex);
+    m_resourceData = std::make_shared<ResourceData>();
+
+    std::optional<SceneHandle> scene;
+    if (path.extension() == COOKED_SCENE_EXTENSION) {
+        const CookedScene cookedScene(path);
+        scene = build_scene(cookedScene);
+    }
+    else {
+        auto gltf = parse_gltf(path);
+        if (!gltf.has_value())
+            throw std::runtime_error("Failed to parse scene " + path.string());
+
+        scene = build_scene(gltf.value());
+    }
+    if (!scene.has_value())
+        throw std::runtime_error("Failed to build scene " + path.string());
+
+    // Only hand the scene out once the transfer queue is done with it, so publishing never waits on uploads.
+    m_stagingRing->wait_idle();
+
+    LoadedScene loadedScene;
+    loadedScene.resourceData = std::move(m_resourceData);
+    loadedScene.scene = scene.value();
+    return loadedScene;
+}
+
+std::future<LoadedScene> SceneBuilder::load_scene_async(std::filesystem::path path) {
+    return std::async(std::launch::async, [this, path = std::move(path)] { return load_scene(path); });
 }
 
-std::optional<fastgltf::Asset> SceneBuilder::parse_gltf(const std::filesystem::path &path) const {
-    fastgltf::Parser parser(fastgltf::Extensions::KHR_lights_punctual);
+std::optional<fastgltf::Asset> SceneBuilder::parse_gltf(const std::filesystem::path &path) {
+    // Quantized attributes are widened to float by the accessor iterators and repacked per surface if requested.
+    fastgltf::Parser parser(fastgltf::Extensions::KHR_lights_punctual | fastgltf::Extensions::KHR_mesh_quantization);
     constexpr auto options =
         fastgltf::Options::DontRequireValidAssetMember |
             fastgltf::Options::AllowDouble  |
@@ -297,48 +924,97 @@ std::optional<fastgltf::Asset> SceneBuilder::parse_gltf(const std::filesystem::p
 
 std::optional<SceneHandle> SceneBuilder::build_scene(fastgltf::Asset &asset) {
     Scene newScene;
-    auto textureData = ktx_texture_data_from_gltf(asset);
-    const auto geoData = create_meshes(asset, newScene);
-    create_materials(asset, newScene);
-    create_lights(asset, newScene);
-    create_samplers(asset, newScene);
-    create_nodes(asset, newScene);
-    create_images(textureData.texturePs, newScene);
+    auto& resourceData = *m_resourceData;
+    auto textureData = ktx_texture_data_from_gltf(asset, m_jobSystem);
+    const auto& texturePs = textureData.texturePs;
+
+    // Textures own their image data until it has been copied into staging, every exit path has to destroy them.
+    const auto destroyTextures = [&] {
+        for (const auto texture : texturePs)
+            ktxTexture_Destroy(texture);
+    };
 
-    upload_scene_data(geoData, textureData);
+    try {
+        const auto geoData = create_meshes(asset, newScene, resourceData, m_importOptions);
+        create_materials(asset, newScene, resourceData);
+        create_lights(asset, newScene, resourceData);
+        const auto samplerInfos = create_sampler_infos(asset, newScene, resourceData);
+        create_nodes(asset, newScene, resourceData);
+        const auto textureInfos = create_texture_infos(texturePs, newScene, resourceData);
+
+        create_samplers(samplerInfos);
+        create_images(textureInfos);
+        upload_scene_buffers(geoData);
+
+        std::vector<TextureUpload> uploads(texturePs.size());
+        for (u64 i = 0; i < texturePs.size(); i++)
+            uploads[i] = {texturePs[i]->dataSize, textureData.copyRegions[i]};
+
+        upload_textures(uploads, [&](const u64 index, u8* destination) {
+            const ktxTexture* texture = texturePs[index];
+            memcpy(destination, texture->pData, texture->dataSize);
+        });
+    }
+    catch (...) {
+        destroyTextures();
+        throw;
+    }
+    destroyTextures();
+
+    return add_scene(std::move(newScene));
+}
 
+SceneHandle SceneBuilder::add_scene(Scene&& scene) const {
     auto& scenes = m_resourceData->scenes;
     auto& sceneMetadata = m_resourceData->sceneMetadata;
     u16 metadata = scenes.size();
     auto handle = static_cast<SceneHandle>(metadata << 16 | scenes.size());
 
-    scenes.push_back(std::move(newScene));
+    scenes.push_back(std::move(scene));
     sceneMetadata.push_back(metadata);
 
     return handle;
 }
 
-void SceneBuilder::write_textures(DescriptorBuilder &builder) const {
-    u32 i = 0;
-    for (const auto& texture : m_resourceData->textures) {
-        const auto sampler = m_resourceData->samplers[0];
-        builder.write_image(i, texture.view, sampler.sampler, vk::ImageLayout::eShaderReadOnlyOptimal, vk::DescriptorType::eCombinedImageSampler);
-        i++;
-    }
-}
-
-void SceneBuilder::create_nodes(const fastgltf::Asset& asset, Scene& scene) const {
-    auto& nodes = m_resourceData->nodes;
-    auto& nodeMetadata = m_resourceData->nodeMetadata;
+void SceneBuilder::create_nodes(const fastgltf::Asset& asset, Scene& scene, ResourceData& resourceData) {
+    auto& nodes = resourceData.nodes;
+    auto& nodeMetadata = resourceData.nodeMetadata;
+    auto& localMatrices = resourceData.nodeLocalMatrices;
+    auto& worldMatrices = resourceData.nodeWorldMatrices;
+    auto& parents = resourceData.nodeParents;
     const auto numGltfNodes = nodes.size();
     nodes.reserve(numGltfNodes + asset.nodes.size());
-
-    for (const auto& gltfNode : asset.nodes) {
+    nodeMetadata.reserve(numGltfNodes + asset.nodes.size());
+    localMatrices.reserve(numGltfNodes + asset.nodes.size());
+    worldMatrices.reserve(numGltfNodes + asset.nodes.size());
+    parents.reserve(numGltfNodes + asset.nodes.size());
+    resourceData.nodeDirty.reserve(numGltfNodes + asset.nodes.size());
+
+    scene.firstNode = static_cast<u32>(numGltfNodes);
+
+    std::vector<bool> isChild(asset.nodes.size());
+    for (const auto& gltfNode : asset.nodes)
+        for (const auto child : gltfNode.children)
+            isChild[child] = true;
+
+    // Depth first walk from every root, so nodes are stored parent before child. Pairs hold the glTF node index
+    // and the stored index of its parent.
+    std::vector<std::pair<u64, u32>> stack;
+    for (u64 i = asset.nodes.size(); i-- > 0;)
+        if (!isChild[i])
+            stack.emplace_back(i, NO_PARENT);
+
+    while (!stack.empty()) {
+        const auto [gltfIndex, parentIndex] = stack.back();
+        stack.pop_back();
+
+        const auto& gltfNode = asset.nodes[gltfIndex];
         Node node;
+        glm::mat4 localMatrix{};
         u16 metadata = nodes.size();
 
         std::visit(fastgltf::visitor { [&](fastgltf::math::fmat4x4 matrix) {
-            memcpy(&node.localMatrix, matrix.data(), sizeof(matrix));
+            memcpy(&localMatrix, matrix.data(), sizeof(matrix));
         },
             [&](fastgltf::TRS transform) {
                 const glm::vec3 translation(transform.translation.x(), transform.translation.y(), transform.translation.z());
@@ -349,25 +1025,29 @@ void SceneBuilder::create_nodes(const fastgltf::Asset& asset, Scene& scene) cons
                 const glm::mat4 rotationMatrix = toMat4(rotation);
                 const glm::mat4 scaleMatrix = glm::scale(glm::mat4(1.0f), scale);
 
-                node.localMatrix = translationMatrix * rotationMatrix * scaleMatrix;
+                localMatrix = translationMatrix * rotationMatrix * scaleMatrix;
             }
         }, gltfNode.transform);
 
 
-        const auto handle = static_cast<NodeHandle>(metadata << 16 | nodes.size());
+        const u32 nodeIndex = static_cast<u32>(nodes.size());
+        const auto handle = static_cast<NodeHandle>(metadata << 16 | nodeIndex);
         scene.nodes.push_back(handle);
 
+        if (parentIndex != NO_PARENT)
+            node.parent = static_cast<NodeHandle>(nodeMetadata[parentIndex] << 16 | parentIndex);
+
         [[likely]] if (gltfNode.meshIndex.has_value()) {
 
             scene.renderableNodes.push_back(handle);
 
-            const u16 meshMetadata = get_metadata_at_index(gltfNode.meshIndex.value());
+            const u16 meshMetadata = resourceData.meshMetadata[gltfNode.meshIndex.value()];
             node.mesh = static_cast<MeshHandle>(meshMetadata << 16 | gltfNode.meshIndex.value());
 
             auto type = MaterialType::opaque;
-            auto mesh = m_resourceData->meshes[get_handle_index(node.mesh)];
+            auto mesh = resourceData.meshes[get_handle_index(node.mesh)];
             for (const auto& surface : mesh.surfaces) {
-                const auto material = m_resourceData->materials[get_handle_index(surface.material)];
+                const auto material = resourceData.materials[get_handle_index(surface.material)];
                 [[unlikely]] if (material.baseColorFactor.a < 1.0f)
                     type = MaterialType::transparent;
             }
@@ -380,25 +1060,40 @@ void SceneBuilder::create_nodes(const fastgltf::Asset& asset, Scene& scene) cons
 
         nodes.push_back(node);
         nodeMetadata.push_back(metadata);
+        localMatrices.push_back(localMatrix);
+        worldMatrices.push_back(parentIndex == NO_PARENT ? localMatrix : worldMatrices[parentIndex] * localMatrix);
+        parents.push_back(parentIndex);
+        resourceData.nodeDirty.push_back(true);
+
+        for (auto child = gltfNode.children.rbegin(); child != gltfNode.children.rend(); ++child)
+            stack.emplace_back(*child, nodeIndex);
     }
 }
 
-GeometricData SceneBuilder::create_meshes(const fastgltf::Asset &asset, Scene &scene) const {
-    auto& meshes = m_resourceData->meshes;
-    auto& meshMetadata = m_resourceData->meshMetadata;
+GeometricData SceneBuilder::create_meshes(const fastgltf::Asset &asset, Scene &scene, ResourceData& resourceData, const SceneImportOptions& importOptions) {
+    auto& meshes = resourceData.meshes;
+    auto& meshMetadata = resourceData.meshMetadata;
     const auto numGltfMeshes = asset.meshes.size();
     meshes.reserve(numGltfMeshes + asset.meshes.size());
     meshMetadata.reserve(numGltfMeshes + asset.meshes.size());
 
     std::vector<u32> indices;
+    std::vector<u16> indices16;
+    std::vector<u32> surfaceIndices;
     std::vector<Vertex> vertices;
+    std::vector<u32> packedVertices;
+    std::vector<u32> positions;
+    std::vector<Meshlet> meshlets;
+    std::vector<u32> meshletData;
+    std::vector<u32> lodIndices;
+    MeshImportStats stats;
+    const bool optimizeMeshes = importOptions.optimizeMeshes;
+    resourceData.vertexFormat = importOptions.packVertices ? VertexFormat::Packed : VertexFormat::Full;
 
     for (const auto& gltfMesh : asset.meshes) {
         Mesh mesh;
         for (auto&& primitive : gltfMesh.primitives) {
             Surface newSurface;
-            newSurface.initialIndex = indices.size();
-            newSurface.indexCount = asset.accessors[primitive.indicesAccessor.value()].count;
 
             if (primitive.materialIndex.has_value())
                 newSurface.material = static_cast<MaterialHandle>(primitive.materialIndex.value());
@@ -407,14 +1102,21 @@ GeometricData SceneBuilder::create_meshes(const fastgltf::Asset &asset, Scene &s
             u64 initialVertex = vertices.size();
             {
                 auto& indexAccessor = asset.accessors[primitive.indicesAccessor.value()];
-                indices.reserve(indices.size() + indexAccessor.count);
+                surfaceIndices.clear();
+                surfaceIndices.reserve(indexAccessor.count);
 
                 fastgltf::iterateAccessor<u32>(asset, indexAccessor,
                     [&](u32 idx) {
-                    indices.push_back(idx + initialVertex);
+                    surfaceIndices.push_back(idx);
                 });
             }
 
+            triangulate_surface(primitive.type, surfaceIndices);
+            newSurface.indexCount = static_cast<u32>(surfaceIndices.size());
+            const bool triangles = primitive.type == fastgltf::PrimitiveType::Triangles ||
+                primitive.type == fastgltf::PrimitiveType::TriangleStrip ||
+                primitive.type == fastgltf::PrimitiveType::TriangleFan;
+
             {
                 auto& positionAccessor = asset.accessors[primitive.findAttribute("POSITION")->accessorIndex];
                 vertices.resize(vertices.size() + positionAccessor.count);
@@ -449,13 +1151,18 @@ GeometricData SceneBuilder::create_meshes(const fastgltf::Asset &asset, Scene &s
                     });
             }
 
-            if (auto colors = primitive.findAttribute("COLOR_0"); colors != primitive.attributes.end()) {
+            const auto colors = primitive.findAttribute("COLOR_0");
+            const bool hasColour = colors != primitive.attributes.end();
+            if (hasColour) {
                 fastgltf::iterateAccessorWithIndex<glm::vec4>(asset, asset.accessors[colors->accessorIndex],
                 [&](glm::vec4 v, u64 index) {
                     vertices[initialVertex + index].colour = v;
                 });
             }
 
+            if (optimizeMeshes && triangles)
+                optimize_surface(vertices, surfaceIndices, initialVertex, stats.optimization);
+
             glm::vec3 min = vertices[initialVertex].position;
             glm::vec3 max = vertices[initialVertex].position;
             for (u64 i = initialVertex; i < vertices.size(); i++) {
@@ -464,6 +1171,58 @@ GeometricData SceneBuilder::create_meshes(const fastgltf::Asset &asset, Scene &s
             }
 
             newSurface.boundingVolume = {min, max};
+            newSurface.firstVertex = static_cast<u32>(initialVertex);
+            newSurface.vertexCount = static_cast<u32>(vertices.size() - initialVertex);
+
+            lodIndices.clear();
+            if (importOptions.generateLods && triangles)
+                build_lods(std::span(vertices).subspan(initialVertex), surfaceIndices, newSurface, lodIndices);
+
+            // Indices stay local to the surface, so every surface with fewer than 65536 vertices fits 16 bit indices
+            // wherever its vertices are stored.
+            if (newSurface.vertexCount <= std::numeric_limits<u16>::max()) {
+                newSurface.indexType = vk::IndexType::eUint16;
+                newSurface.initialIndex = static_cast<u32>(indices16.size());
+                indices16.insert(indices16.end(), surfaceIndices.begin(), surfaceIndices.end());
+                indices16.insert(indices16.end(), lodIndices.begin(), lodIndices.end());
+            }
+            else {
+                newSurface.initialIndex = static_cast<u32>(indices.size());
+                indices.insert(indices.end(), surfaceIndices.begin(), surfaceIndices.end());
+                indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+            }
+
+            newSurface.lods[0] = {newSurface.initialIndex, newSurface.indexCount, 0.0f};
+            for (u32 i = 1; i < newSurface.lodCount; i++)
+                newSurface.lods[i].initialIndex += newSurface.initialIndex;
+            stats.lodTriangleCount += lodIndices.size() / 3;
+
+            newSurface.doubleSided = primitive.materialIndex.has_value() && asset.materials[primitive.materialIndex.value()].doubleSided;
+            if (triangles) {
+                build_meshlets(std::span(vertices).subspan(initialVertex), surfaceIndices, newSurface, meshlets, meshletData);
+                stats.fullDetailMeshletCount += newSurface.meshletCount;
+                if (importOptions.buildClusterLods)
+                    build_cluster_lods(std::span(vertices).subspan(initialVertex), newSurface, meshlets, meshletData);
+            }
+
+            if (importOptions.packVertices) {
+                pack_surface(std::span(vertices).subspan(initialVertex), newSurface, hasColour, packedVertices);
+
+                // The same quantized words the packed vertex holds, so both streams decode to identical positions.
+                for (u32 i = 0; i < newSurface.vertexCount; i++) {
+                    const u32 base = newSurface.packedOffset + i * newSurface.packedStride;
+                    positions.push_back(packedVertices[base]);
+                    positions.push_back(packedVertices[base + 1] & 0xffff);
+                }
+            }
+            else {
+                for (u64 i = initialVertex; i < vertices.size(); i++) {
+                    const glm::vec3& position = vertices[i].position;
+                    positions.push_back(std::bit_cast<u32>(position.x));
+                    positions.push_back(std::bit_cast<u32>(position.y));
+                    positions.push_back(std::bit_cast<u32>(position.z));
+                }
+            }
             mesh.surfaces.push_back(newSurface);
         }
 
@@ -474,12 +1233,386 @@ GeometricData SceneBuilder::create_meshes(const fastgltf::Asset &asset, Scene &s
         meshMetadata.push_back(metadata);
     }
 
-    return {vertices, indices };
+    stats.indexCount16 = indices16.size();
+    stats.indexCount32 = indices.size();
+    stats.meshletCount = meshlets.size();
+    stats.meshletBytes = meshlets.size() * sizeof(Meshlet) + meshletData.size() * sizeof(u32);
+    stats.vertexCount = vertices.size();
+    stats.fullVertexBytes = vertices.size() * sizeof(Vertex);
+    stats.packedVertexBytes = packedVertices.size() * sizeof(u32);
+    if (importOptions.printStats)
+        print_import_stats(stats, importOptions);
+
+    // Packed scenes only keep the full vertices around until every surface is packed.
+    if (importOptions.packVertices)
+        return {{}, std::move(indices), std::move(indices16), std::move(packedVertices), std::move(positions), std::move(meshlets), std::move(meshletData)};
+
+    return {std::move(vertices), std::move(indices), std::move(indices16), {}, std::move(positions), std::move(meshlets), std::move(meshletData)};
 }
 
-void SceneBuilder::create_materials(const fastgltf::Asset &asset, Scene &scene) const {
-    auto& materials = m_resourceData->materials;
-    auto& materialMetadata = m_resourceData->materialMetadata;
+void SceneBuilder::print_import_stats(const MeshImportStats& stats, const SceneImportOptions& importOptions) {
+    constexpr f64 mebibyte = 1 << 20;
+    const auto& optimization = stats.optimization;
+    if (importOptions.optimizeMeshes && optimization.triangleCount > 0) {
+        const auto triangles = static_cast<f64>(optimization.triangleCount);
+        const auto coveredPixels = static_cast<f64>(std::max<u64>(optimization.coveredPixels, 1));
+        std::println("Optimized {} surfaces: vertices {} -> {}, ACMR {:.3f} -> {:.3f}, overdraw {:.3f} -> {:.3f}",
+            optimization.surfaceCount, optimization.verticesBefore, optimization.verticesAfter,
+            static_cast<f64>(optimization.transformedVerticesBefore) / triangles,
+            static_cast<f64>(optimization.transformedVerticesAfter) / triangles,
+            static_cast<f64>(optimization.shadedPixelsBefore) / coveredPixels,
+            static_cast<f64>(optimization.shadedPixelsAfter) / coveredPixels);
+    }
+
+    std::println("Stored {} of {} indices as 16 bit, {:.1f} MiB of index data", stats.indexCount16, stats.indexCount16 + stats.indexCount32,
+        static_cast<f64>(stats.indexCount16 * sizeof(u16) + stats.indexCount32 * sizeof(u32)) / mebibyte);
+    std::println("Built {} meshlets, {} of them cluster LODs, {:.1f} MiB of meshlet data", stats.meshletCount,
+        stats.meshletCount - stats.fullDetailMeshletCount, static_cast<f64>(stats.meshletBytes) / mebibyte);
+    if (importOptions.generateLods)
+        std::println("Simplified {} triangles of LODs", stats.lodTriangleCount);
+    if (importOptions.packVertices)
+        std::println("Packed {} vertices from {:.1f} MiB to {:.1f} MiB", stats.vertexCount,
+            static_cast<f64>(stats.fullVertexBytes) / mebibyte, static_cast<f64>(stats.packedVertexBytes) / mebibyte);
+}
+
+void SceneBuilder::triangulate_surface(const fastgltf::PrimitiveType type, std::vector<u32>& surfaceIndices) {
+    if (type != fastgltf::PrimitiveType::TriangleStrip && type != fastgltf::PrimitiveType::TriangleFan)
+        return;
+
+    std::vector<u32> triangles;
+    triangles.reserve(surfaceIndices.size() < 3 ? 0 : (surfaceIndices.size() - 2) * 3);
+    for (u64 i = 2; i < surfaceIndices.size(); i++) {
+        u32 a = surfaceIndices[i - 2];
+        u32 b = surfaceIndices[i - 1];
+        const u32 c = surfaceIndices[i];
+        if (type == fastgltf::PrimitiveType::TriangleFan)
+            a = surfaceIndices[0];
+        // Every other strip triangle is wound the other way round.
+        else if (i % 2 == 1)
+            std::swap(a, b);
+
+        if (a == b || b == c || a == c)
+            continue;
+        triangles.insert(triangles.end(), {a, b, c});
+    }
+    surfaceIndices = std::move(triangles);
+}
+
+namespace {
+    u32 quantize_unorm16(const f32 value, const f32 min, const f32 extent) {
+        if (extent <= 0.0f)
+            return 0;
+        return static_cast<u32>(std::lround(std::clamp((value - min) / extent, 0.0f, 1.0f) * 65535.0f));
+    }
+
+    u32 quantize_snorm8(const f32 value) {
+        return static_cast<u32>(static_cast<i32>(std::lround(std::clamp(value, -1.0f, 1.0f) * 127.0f))) & 0xff;
+    }
+
+    // Octahedral mapping onto [-1, 1]^2, the lower hemisphere is folded over the diagonals.
+    glm::vec2 octahedral_encode(glm::vec3 normal) {
+        const f32 length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (length == 0.0f)
+            return {0.0f, 0.0f};
+        normal /= length;
+
+        glm::vec2 encoded(normal.x, normal.y);
+        if (normal.z < 0.0f) {
+            const glm::vec2 sign(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+            encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign;
+        }
+        return encoded;
+    }
+}
+
+void SceneBuilder::pack_surface(const std::span<const Vertex> vertices, Surface& surface, const bool hasColour, std::vector<u32>& packedVertices) {
+    const u32 stride = hasColour ? PACKED_COLOUR_VERTEX_WORDS : PACKED_VERTEX_WORDS;
+    surface.packedOffset = static_cast<u32>(packedVertices.size());
+    surface.packedStride = stride;
+    packedVertices.reserve(packedVertices.size() + vertices.size() * stride);
+
+    // Positions are relative to the same box the GPU surface bounds are built from, so the shader needs no extra data.
+    const auto& [min, max] = surface.boundingVolume;
+    const glm::vec3 extent = max - min;
+
+    for (const auto& [position, uvX, normal, uvY, colour] : vertices) {
+        const u32 x = quantize_unorm16(position.x, min.x, extent.x);
+        const u32 y = quantize_unorm16(position.y, min.y, extent.y);
+        const u32 z = quantize_unorm16(position.z, min.z, extent.z);
+        const glm::vec2 octahedral = octahedral_encode(normal);
+
+        packedVertices.push_back(x | y << 16);
+        packedVertices.push_back(z | quantize_snorm8(octahedral.x) << 16 | quantize_snorm8(octahedral.y) << 24);
+        packedVertices.push_back(glm::packHalf2x16({uvX, uvY}));
+        if (hasColour)
+            packedVertices.push_back(glm::packUnorm4x8(colour));
+    }
+}
+
+namespace {
+    // Splits the triangles into meshlets appended to meshlets and meshletData, each with its own bounding sphere as its
+    // LOD bounds. Returns how many were added.
+    u32 append_meshlets(
+        const std::span<const Vertex> vertices,
+        const std::span<const u32> indices,
+        const bool doubleSided,
+        std::vector<Meshlet>& meshlets,
+        std::vector<u32>& meshletData)
+    {
+        // The cone weight trades meshlet compactness for tighter cones, which double sided surfaces never use.
+        const f32 coneWeight = doubleSided ? 0.0f : 0.25f;
+        const u64 maxMeshlets = meshopt_buildMeshletsBound(indices.size(), MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+        std::vector<meshopt_Meshlet> surfaceMeshlets(maxMeshlets);
+        std::vector<u32> meshletVertices(maxMeshlets * MESHLET_MAX_VERTICES);
+        std::vector<u8> meshletTriangles(maxMeshlets * MESHLET_MAX_TRIANGLES * 3);
+
+        const f32* positions = &vertices.front().position.x;
+        const u64 meshletCount = meshopt_buildMeshlets(
+            surfaceMeshlets.data(), meshletVertices.data(), meshletTriangles.data(),
+            indices.data(), indices.size(), positions, vertices.size(), sizeof(Vertex),
+            MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES, coneWeight);
+
+        meshlets.reserve(meshlets.size() + meshletCount);
+        for (u64 i = 0; i < meshletCount; i++) {
+            const auto& [vertexOffset, triangleOffset, vertexCount, triangleCount] = surfaceMeshlets[i];
+            u32* localVertices = &meshletVertices[vertexOffset];
+            u8* localTriangles = &meshletTriangles[triangleOffset];
+            meshopt_optimizeMeshlet(localVertices, localTriangles, triangleCount, vertexCount);
+            const auto bounds = meshopt_computeMeshletBounds(localVertices, localTriangles, triangleCount, positions, vertices.size(), sizeof(Vertex));
+
+            Meshlet meshlet;
+            meshlet.center = glm::make_vec3(bounds.center);
+            meshlet.radius = bounds.radius;
+            meshlet.coneApex = glm::make_vec3(bounds.cone_apex);
+            meshlet.coneAxis = glm::make_vec3(bounds.cone_axis);
+            meshlet.coneCutoff = doubleSided ? 1.0f : bounds.cone_cutoff;
+            meshlet.dataOffset = static_cast<u32>(meshletData.size());
+            meshlet.vertexCount = vertexCount;
+            meshlet.triangleCount = triangleCount;
+            meshlet.lodBounds = glm::vec4(meshlet.center, meshlet.radius);
+            meshlets.push_back(meshlet);
+
+            meshletData.insert(meshletData.end(), localVertices, localVertices + vertexCount);
+            for (u32 t = 0; t < triangleCount; t++) {
+                const u8* triangle = localTriangles + t * 3;
+                meshletData.push_back(triangle[0] | triangle[1] << 8 | triangle[2] << 16);
+            }
+        }
+        return static_cast<u32>(meshletCount);
+    }
+
+    // Appends the meshlet's triangles as surface local indices.
+    void append_meshlet_indices(const Meshlet& meshlet, const std::span<const u32> meshletData, std::vector<u32>& indices) {
+        const u32* localVertices = &meshletData[meshlet.dataOffset];
+        const u32* triangles = localVertices + meshlet.vertexCount;
+        for (u32 t = 0; t < meshlet.triangleCount; t++) {
+            indices.push_back(localVertices[triangles[t] & 0xff]);
+            indices.push_back(localVertices[(triangles[t] >> 8) & 0xff]);
+            indices.push_back(localVertices[triangles[t] >> 16]);
+        }
+    }
+}
+
+void SceneBuilder::build_meshlets(
+    const std::span<const Vertex> vertices,
+    const std::span<const u32> surfaceIndices,
+    Surface& surface,
+    std::vector<Meshlet>& meshlets,
+    std::vector<u32>& meshletData)
+{
+    surface.firstMeshlet = static_cast<u32>(meshlets.size());
+    surface.meshletCount = 0;
+    if (surfaceIndices.empty() || surfaceIndices.size() % 3 != 0)
+        return;
+
+    surface.meshletCount = append_meshlets(vertices, surfaceIndices, surface.doubleSided, meshlets, meshletData);
+}
+
+void SceneBuilder::build_cluster_lods(
+    const std::span<const Vertex> vertices,
+    Surface& surface,
+    std::vector<Meshlet>& meshlets,
+    std::vector<u32>& meshletData)
+{
+    if (surface.meshletCount < 2)
+        return;
+
+    const f32* positions = &vertices[0].position.x;
+    // Meshlets on either side of a UV or normal seam share positions but not vertices, grouping by position keeps them
+    // neighbours.
+    std::vector<u32> positionRemap(vertices.size());
+    meshopt_generatePositionRemap(positionRemap.data(), positions, vertices.size(), sizeof(Vertex));
+
+    std::vector<u32> pending(surface.meshletCount);
+    std::iota(pending.begin(), pending.end(), surface.firstMeshlet);
+    std::vector<u32> next;
+    std::vector<u32> clusterIndices;
+    std::vector<u32> clusterIndexCounts;
+    std::vector<u32> partition;
+    std::vector<std::vector<u32>> groups;
+    std::vector<u32> groupIndices;
+    std::vector<u32> simplified;
+    std::vector<glm::vec4> groupSpheres;
+
+    while (pending.size() > 1) {
+        clusterIndices.clear();
+        clusterIndexCounts.clear();
+        for (const u32 meshletIndex : pending) {
+            const u64 first = clusterIndices.size();
+            append_meshlet_indices(meshlets[meshletIndex], meshletData, clusterIndices);
+            for (u64 i = first; i < clusterIndices.size(); i++)
+                clusterIndices[i] = positionRemap[clusterIndices[i]];
+            clusterIndexCounts.push_back(static_cast<u32>(clusterIndices.size() - first));
+        }
+
+        partition.resize(pending.size());
+        const u64 groupCount = meshopt_partitionClusters(
+            partition.data(), clusterIndices.data(), clusterIndices.size(), clusterIndexCounts.data(), pending.size(),
+            positions, vertices.size(), sizeof(Vertex), CLUSTER_GROUP_SIZE);
+        groups.assign(groupCount, {});
+        for (u64 i = 0; i < pending.size(); i++)
+            groups[partition[i]].push_back(pending[i]);
+
+        next.clear();
+        for (const auto& group : groups) {
+            groupIndices.clear();
+            for (const u32 meshletIndex : group)
+                append_meshlet_indices(meshlets[meshletIndex], meshletData, groupIndices);
+
+            // Locking the group's border keeps it watertight against its neighbours whichever of their levels is
+            // drawn, the border is only simplified once it lies inside a coarser group.
+            f32 error = 0.0f;
+            simplified.resize(groupIndices.size());
+            const u64 indexCount = meshopt_simplify(
+                simplified.data(), groupIndices.data(), groupIndices.size(),
+                positions, vertices.size(), sizeof(Vertex),
+                groupIndices.size() / 6 * 3, std::numeric_limits<f32>::max(),
+                meshopt_SimplifyLockBorder | meshopt_SimplifySparse | meshopt_SimplifyErrorAbsolute, &error);
+
+            // A group that loses less than a sixth of its triangles is not worth another level, its meshlets stay
+            // roots of the DAG.
+            if (indexCount == 0 || indexCount * 6 > groupIndices.size() * 5)
+                continue;
+
+            // Each round simplifies the last round's result, so the deviation from full detail is this round's error
+            // on top of the largest one its meshlets already carry. With the group's sphere enclosing its meshlets'
+            // the projected error never decreases from a meshlet to its parent, and every path through the DAG
+            // crosses the threshold once.
+            groupSpheres.clear();
+            f32 childError = 0.0f;
+            for (const u32 meshletIndex : group) {
+                groupSpheres.push_back(meshlets[meshletIndex].lodBounds);
+                childError = std::max(childError, meshlets[meshletIndex].lodError);
+            }
+            error += childError;
+            const auto groupBounds = meshopt_computeSphereBounds(
+                &groupSpheres[0].x, groupSpheres.size(), sizeof(glm::vec4), &groupSpheres[0].w, sizeof(glm::vec4));
+            const glm::vec4 groupSphere(glm::make_vec3(groupBounds.center), groupBounds.radius);
+
+            for (const u32 meshletIndex : group) {
+                meshlets[meshletIndex].parentError = error;
+                meshlets[meshletIndex].parentBounds = groupSphere;
+            }
+
+            const u32 firstMeshlet = static_cast<u32>(meshlets.size());
+            const u32 meshletCount = append_meshlets(vertices, std::span(simplified).first(indexCount), surface.doubleSided, meshlets, meshletData);
+            for (u32 i = firstMeshlet; i < firstMeshlet + meshletCount; i++) {
+                meshlets[i].lodError = error;
+                meshlets[i].lodBounds = groupSphere;
+                next.push_back(i);
+            }
+        }
+
+        pending.swap(next);
+    }
+
+    surface.meshletCount = static_cast<u32>(meshlets.size()) - surface.firstMeshlet;
+}
+
+void SceneBuilder::build_lods(
+    const std::span<const Vertex> vertices,
+    const std::span<const u32> surfaceIndices,
+    Surface& surface,
+    std::vector<u32>& lodIndices)
+{
+    if (surfaceIndices.empty() || surfaceIndices.size() % 3 != 0)
+        return;
+
+    const f32* positions = &vertices[0].position.x;
+    // meshopt_simplify reports errors relative to the surface's extent.
+    const f32 errorScale = meshopt_simplifyScale(positions, vertices.size(), sizeof(Vertex));
+    std::vector<u32> simplified(surfaceIndices.size());
+
+    // Every level is simplified from full detail so errors do not compound. The chain ends at the first level that
+    // removes less than a quarter of the triangles of the one before.
+    u64 previousCount = surfaceIndices.size();
+    for (u32 level = 1; level < MAX_SURFACE_LODS; level++) {
+        const u64 targetCount = (surfaceIndices.size() >> level) / 3 * 3;
+        if (targetCount < LOD_MIN_TRIANGLES * 3)
+            break;
+
+        f32 error = 0.0f;
+        const u64 indexCount = meshopt_simplify(
+            simplified.data(), surfaceIndices.data(), surfaceIndices.size(),
+            positions, vertices.size(), sizeof(Vertex),
+            targetCount, LOD_MAX_ERROR, meshopt_SimplifyLockBorder, &error);
+        if (indexCount == 0 || indexCount * 4 > previousCount * 3)
+            break;
+
+        meshopt_optimizeVertexCache(simplified.data(), simplified.data(), indexCount, vertices.size());
+
+        auto& lod = surface.lods[surface.lodCount];
+        lod.initialIndex = static_cast<u32>(surfaceIndices.size() + lodIndices.size());
+        lod.indexCount = static_cast<u32>(indexCount);
+        lod.error = std::max(error * errorScale, surface.lods[surface.lodCount - 1].error);
+        surface.lodCount++;
+
+        lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.begin() + static_cast<i64>(indexCount));
+        previousCount = indexCount;
+    }
+}
+
+void SceneBuilder::optimize_surface(std::vector<Vertex>& vertices, const std::span<u32> surfaceIndices, const u64 firstVertex, MeshOptimizationStats& stats) {
+    const u64 indexCount = surfaceIndices.size();
+    const u64 vertexCount = vertices.size() - firstVertex;
+    if (indexCount == 0 || indexCount % 3 != 0)
+        return;
+
+    Vertex* surfaceVertices = vertices.data() + firstVertex;
+
+    // Statistics use the same cache model for before and after, the overdraw is measured from several directions.
+    constexpr u32 cacheSize = 32;
+    const auto analyze = [&](const u64 count, u64& transformedVertices, u64& shadedPixels) {
+        const auto cacheStats = meshopt_analyzeVertexCache(surfaceIndices.data(), indexCount, count, cacheSize, 0, 0);
+        const auto overdrawStats = meshopt_analyzeOverdraw(surfaceIndices.data(), indexCount, &surfaceVertices->position.x, count, sizeof(Vertex));
+        transformedVertices += cacheStats.vertices_transformed;
+        shadedPixels += overdrawStats.pixels_shaded;
+        return overdrawStats.pixels_covered;
+    };
+    stats.coveredPixels += analyze(vertexCount, stats.transformedVerticesBefore, stats.shadedPixelsBefore);
+
+    std::vector<u32> remap(vertexCount);
+    const u64 uniqueCount = meshopt_generateVertexRemap(remap.data(), surfaceIndices.data(), indexCount, surfaceVertices, vertexCount, sizeof(Vertex));
+    meshopt_remapIndexBuffer(surfaceIndices.data(), surfaceIndices.data(), indexCount, remap.data());
+    meshopt_remapVertexBuffer(surfaceVertices, surfaceVertices, vertexCount, sizeof(Vertex), remap.data());
+
+    meshopt_optimizeVertexCache(surfaceIndices.data(), surfaceIndices.data(), indexCount, uniqueCount);
+    // Allows the ACMR to get 5% worse in exchange for less overdraw.
+    meshopt_optimizeOverdraw(surfaceIndices.data(), surfaceIndices.data(), indexCount, &surfaceVertices->position.x, uniqueCount, sizeof(Vertex), 1.05f);
+    const u64 fetchedCount = meshopt_optimizeVertexFetch(surfaceVertices, surfaceIndices.data(), indexCount, surfaceVertices, uniqueCount, sizeof(Vertex));
+
+    analyze(fetchedCount, stats.transformedVerticesAfter, stats.shadedPixelsAfter);
+    stats.surfaceCount++;
+    stats.triangleCount += indexCount / 3;
+    stats.verticesBefore += vertexCount;
+    stats.verticesAfter += fetchedCount;
+
+    vertices.resize(firstVertex + fetchedCount);
+}
+
+void SceneBuilder::create_materials(const fastgltf::Asset &asset, Scene &scene, ResourceData& resourceData) {
+    auto& materials = resourceData.materials;
+    auto& materialMetadata = resourceData.materialMetadata;
     const auto numGltfMaterials = materials.size();
     materials.reserve(numGltfMaterials + materials.size());
 
@@ -561,39 +1694,43 @@ inline vk::SamplerMipmapMode convert_mipmap_mode(const fastgltf::Filter filter)
     }
 }
 
-void SceneBuilder::create_samplers(const fastgltf::Asset& asset, Scene& scene) const {
-    auto& samplers = m_resourceData->samplers;
-    auto& samplerMetadata = m_resourceData->samplerMetadata;
-    const auto numGltfSamplers = samplers.size();
-    samplers.reserve(numGltfSamplers + samplers.size());
+std::vector<SamplerInfo> SceneBuilder::create_sampler_infos(const fastgltf::Asset& asset, Scene& scene, ResourceData& resourceData) {
+    auto& samplerMetadata = resourceData.samplerMetadata;
+    // Handles index the samplers created from the returned infos, which are appended after the existing ones.
+    const auto firstSampler = resourceData.samplers.size();
 
-    samplers.reserve(asset.samplers.size());
+    std::vector<SamplerInfo> samplerInfos;
+    samplerInfos.reserve(asset.samplers.size());
     for (const auto& gltfSampler : asset.samplers) {
-        vk::SamplerCreateInfo samplerInfo;
+        SamplerInfo samplerInfo;
         samplerInfo.magFilter = convert_filter(gltfSampler.magFilter.value_or(fastgltf::Filter::Nearest));
         samplerInfo.minFilter = convert_filter(gltfSampler.minFilter.value_or(fastgltf::Filter::Nearest));
-        samplerInfo.maxLod = vk::LodClampNone;
-        samplerInfo.minLod = 0;
-        samplerInfo.mipmapMode = convert_mipmap_mode(gltfSampler.minFilter.value_or(fastgltf::Filter::Nearest));
-
-        auto magFilter = convert_filter(gltfSampler.magFilter.value_or(fastgltf::Filter::Nearest));
-        const auto minFilter = convert_filter(gltfSampler.minFilter.value_or(fastgltf::Filter::Nearest));
-        const auto mipMapMode = convert_mipmap_mode(gltfSampler.minFilter.value_or(magFilter));
+        samplerInfo.mipmapMode = convert_mipmap_mode(gltfSampler.minFilter.value_or(gltfSampler.magFilter.value_or(fastgltf::Filter::Nearest)));
 
-        Sampler sampler = m_context.create_sampler(magFilter, minFilter, mipMapMode);
-        u16 metaData = samplers.size();
+        const u64 index = firstSampler + samplerInfos.size();
+        u16 metaData = index;
 
-        samplers.push_back(sampler);
+        samplerInfos.push_back(samplerInfo);
         samplerMetadata.push_back(metaData);
 
-        const auto handle = static_cast<SamplerHandle>(metaData << 16 | samplers.size());
+        const auto handle = static_cast<SamplerHandle>(metaData << 16 | (index + 1));
         scene.samplers.push_back(handle);
     }
+
+    return samplerInfos;
 }
 
-void SceneBuilder::create_lights(const fastgltf::Asset &asset, Scene &scene) const {
-    auto& lights = m_resourceData->lights;
-    auto& lightMetadata = m_resourceData->samplerMetadata;
+void SceneBuilder::create_samplers(const std::span<const SamplerInfo> samplerInfos) const {
+    auto& samplers = m_resourceData->samplers;
+    samplers.reserve(samplers.size() + samplerInfos.size());
+
+    for (const auto& [magFilter, minFilter, mipmapMode] : samplerInfos)
+        samplers.push_back(m_context.create_sampler(magFilter, minFilter, mipmapMode));
+}
+
+void SceneBuilder::create_lights(const fastgltf::Asset &asset, Scene &scene, ResourceData& resourceData) {
+    auto& lights = resourceData.lights;
+    auto& lightMetadata = resourceData.samplerMetadata;
     const auto numGltfLights = lights.size();
     lights.reserve(numGltfLights + lights.size());
 
@@ -601,7 +1738,7 @@ void SceneBuilder::create_lights(const fastgltf::Asset &asset, Scene &scene) con
         Light light;
         u16 metaData = lightMetadata.size();
 
-        m_resourceData->lightNames.append(std::to_string(lights.size()) + '\0');
+        resourceData.lightNames.append(std::to_string(lights.size()) + '\0');
 
         light.colour = {gltfLight.color.x(), gltfLight.color.y(), gltfLight.color.z()};
         light.intensity = gltfLight.intensity;
@@ -621,304 +1758,290 @@ void SceneBuilder::create_lights(const fastgltf::Asset &asset, Scene &scene) con
     }
 }
 
-void SceneBuilder::create_images(const std::vector<ktxTexture*>& ktxTexturePs, Scene &scene) const {
+std::vector<TextureInfo> SceneBuilder::create_texture_infos(const std::vector<ktxTexture*>& ktxTexturePs, Scene &scene, ResourceData& resourceData) {
+    auto& textureMetadata = resourceData.texturesMetadata;
+    const auto firstTexture = resourceData.textures.size();
+
+    std::vector<TextureInfo> textureInfos;
+    textureInfos.reserve(ktxTexturePs.size());
+    for (const auto ktxTextureP : ktxTexturePs) {
+        const u64 index = firstTexture + textureInfos.size();
+        u16 metadata = index;
 
+        const auto handle = static_cast<TextureHandle>(metadata << 16 | index);
+        scene.textures.push_back(handle);
+
+        textureInfos.push_back({ktxTextureP->baseWidth, ktxTextureP->baseHeight, ktxTextureP->numLevels});
+        textureMetadata.push_back(metadata);
+    }
+
+    return textureInfos;
+}
+
+void SceneBuilder::create_images(const std::span<const TextureInfo> textureInfos) const {
     auto& textures = m_resourceData->textures;
-    auto& textureMetadata = m_resourceData->texturesMetadata;
-    textures.reserve(ktxTexturePs.size());
+    textures.reserve(textures.size() + textureInfos.size());
 
-    for (auto ktxTextureP : ktxTexturePs) {
+    for (const auto& [width, height, levelCount] : textureInfos) {
         Image texture = m_context.create_image(
-            { ktxTextureP->baseWidth, ktxTextureP->baseHeight, 1 },
+            { width, height, 1 },
             VK_FORMAT_BC7_SRGB_BLOCK,
             VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-            ktxTextureP->numLevels,
+            levelCount,
             true
         );
-        u16 metadata = textures.size();
-
-        const auto handle = static_cast<TextureHandle>(metadata << 16 | textures.size());
-        scene.textures.push_back(handle);
-
         textures.push_back(texture);
-        textureMetadata.push_back(metadata);
     }
 }
 
-ktxTextureData SceneBuilder::ktx_texture_data_from_gltf(fastgltf::Asset &asset) {
-    std::vector<ktxTexture*> texturePs;
-    texturePs.reserve(asset.images.size());
-
-    std::vector<std::vector<vk::BufferImageCopy>> copyRegions;
-    copyRegions.reserve(asset.images.size());
-
-    u64 stagingBufferSize = 0;
-
-    for (auto& gltfImage : asset.images) {
-        std::vector<vk::BufferImageCopy> newRegions;
-        std::visit(fastgltf::visitor {
-            [&](auto& arg) {},
-                [&](fastgltf::sources::URI& path) {
-                    std::string prepend = "../assets/scenes/sponza/";
-                    prepend.append(path.uri.c_str());
-
-                    ktxTexture* texture;
-
-                    const ktxResult result = ktxTexture_CreateFromNamedFile(
-                        prepend.c_str(),
-                        KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT,
-                        &texture
-                        );
-
-                    if (result != KTX_SUCCESS)
-                        throw std::runtime_error("Failed to load KTX texture " + prepend);
-
-                    texturePs.push_back(texture);
-                    const ku32 mipLevels = texture->numLevels;
-
-                    for (u32 i = 0; i < mipLevels; i++) {
-                        ku64 imageOffset = stagingBufferSize;
-                        ku64 mipOffset;
-                        if (ktxTexture_GetImageOffset(texture, i, 0, 0, &mipOffset) == KTX_SUCCESS) {
-                            vk::BufferImageCopy copyRegion;
-                            ku64 offset = imageOffset + mipOffset;
-                            copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-                            copyRegion.imageSubresource.mipLevel = i;
-                            copyRegion.imageSubresource.baseArrayLayer = 0;
-                            copyRegion.imageSubresource.layerCount = 1;
-                            copyRegion.imageExtent.width = std::max(1u, texture->baseWidth >> i);
-                            copyRegion.imageExtent.height = std::max(1u, texture->baseHeight >> i);
-                            copyRegion.imageExtent.depth = 1;
-                            copyRegion.bufferOffset = offset;
-
-                            newRegions.push_back(copyRegion);
-                        }
-                    }
-
-                    stagingBufferSize += texture->dataSize;
-            },
+ktxTexture* SceneBuilder::load_ktx_texture(const fastgltf::Asset& asset, const fastgltf::Image& image) {
+    // The image data is read here so the file is closed before the job returns. Deferring the read to upload saved a
+    // host copy of every texture but kept one file open per image, which large scenes run out of.
+    constexpr ktxTextureCreateFlags createFlags = KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT;
+    ktxTexture* texture = nullptr;
+    ktxResult result = KTX_SUCCESS;
+    std::string name = "embedded image";
+
+    std::visit(fastgltf::visitor {
+        [&](const auto& arg) {},
+        [&](const fastgltf::sources::URI& path) {
+            name = "../assets/scenes/sponza/";
+            name.append(path.uri.c_str());
+            result = ktxTexture_CreateFromNamedFile(name.c_str(), createFlags, &texture);
+        },
+        [&](const fastgltf::sources::Array& array) {
+            const auto ktxTextureBytes = reinterpret_cast<const ku8*>(array.bytes.data());
+            result = ktxTexture_CreateFromMemory(ktxTextureBytes, array.bytes.size(), createFlags, &texture);
+        },
+        [&](const fastgltf::sources::BufferView& view) {
+            const auto& bufferView = asset.bufferViews[view.bufferViewIndex];
+            const auto& buffer = asset.buffers[bufferView.bufferIndex];
+
+            std::visit(fastgltf::visitor {
+                [&](const auto& arg) {},
+                [&](const fastgltf::sources::Array& array) {
+                    const auto ktxTextureBytes = reinterpret_cast<const ku8*>(array.bytes.data() + bufferView.byteOffset);
+                    result = ktxTexture_CreateFromMemory(ktxTextureBytes, bufferView.byteLength, createFlags, &texture);
+                }
+            }, buffer.data);
+        }
+    }, image.data);
 
-            [&](fastgltf::sources::Array& array) {
+    if (result != KTX_SUCCESS)
+        throw std::runtime_error("Failed to load KTX texture " + name);
 
-                ku8* ktxTextureData{};
-                ku64 textureSize{};
-                ktxTexture* texture;
+    return texture;
+}
 
-                const ktxResult result = ktxTexture_CreateFromMemory(ktxTextureData, textureSize, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture);
+ktxTextureData SceneBuilder::ktx_texture_data_from_gltf(const fastgltf::Asset &asset, JobSystem& jobSystem) {
+    const auto loadStart = std::chrono::steady_clock::now();
+    const u32 imageCount = static_cast<u32>(asset.images.size());
+
+    // Reading every file is independent, so each image is handled by its own job. Copy regions are relative
+    // to the start of their texture and are offset into the staging ring at upload.
+    std::vector<ktxTexture*> loadedTextures(imageCount);
+    std::vector<std::vector<vk::BufferImageCopy>> loadedRegions(imageCount);
+    std::vector<std::exception_ptr> errors(imageCount);
+
+    jobSystem.parallel_for(imageCount, [&](const u32 index, u32) {
+        try {
+            ktxTexture* texture = load_ktx_texture(asset, asset.images[index]);
+            loadedTextures[index] = texture;
+            if (!texture)
+                return;
+
+            for (u32 i = 0; i < texture->numLevels; i++) {
+                ku64 mipOffset;
+                if (ktxTexture_GetImageOffset(texture, i, 0, 0, &mipOffset) == KTX_SUCCESS) {
+                    vk::BufferImageCopy copyRegion;
+                    copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+                    copyRegion.imageSubresource.mipLevel = i;
+                    copyRegion.imageSubresource.baseArrayLayer = 0;
+                    copyRegion.imageSubresource.layerCount = 1;
+                    copyRegion.imageExtent.width = std::max(1u, texture->baseWidth >> i);
+                    copyRegion.imageExtent.height = std::max(1u, texture->baseHeight >> i);
+                    copyRegion.imageExtent.depth = 1;
+                    copyRegion.bufferOffset = mipOffset;
+
+                    loadedRegions[index].push_back(copyRegion);
+                }
+            }
+        }
+        catch (...) {
+            errors[index] = std::current_exception();
+        }
+    });
+
+    for (u32 i = 0; i < imageCount; i++) {
+        if (errors[i]) {
+            for (const auto texture : loadedTextures)
+                if (texture)
+                    ktxTexture_Destroy(texture);
+            std::rethrow_exception(errors[i]);
+        }
+    }
 
-                if (result != KTX_SUCCESS)
-                    throw std::runtime_error("Failed to load KTX texture");
+    ktxTextureData textureData;
+    textureData.texturePs.reserve(imageCount);
+    textureData.copyRegions.reserve(imageCount);
 
-                const ku32 mipLevels = texture->numLevels;
+    for (u32 i = 0; i < imageCount; i++) {
+        if (!loadedTextures[i])
+            continue;
 
-                stagingBufferSize += textureSize;
+        textureData.texturePs.push_back(loadedTextures[i]);
+        textureData.copyRegions.push_back(std::move(loadedRegions[i]));
+    }
 
-                for (u32 i = 0; i < mipLevels; i++) {
-                    ku64 offset;
-                    if (ktxTexture_GetImageOffset(texture, i, 0, 0, &offset) == KTX_SUCCESS) {
-                        vk::BufferImageCopy copyRegion;
-                        copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-                        copyRegion.imageSubresource.mipLevel = i;
-                        copyRegion.imageSubresource.baseArrayLayer = 0;
-                        copyRegion.imageSubresource.layerCount = 1;
-                        copyRegion.imageExtent.width = std::max(1u, texture->baseWidth >> i);
-                        copyRegion.imageExtent.height = std::max(1u, texture->baseHeight >> i);
-                        copyRegion.imageExtent.depth = 1;
-                        copyRegion.bufferOffset = offset;
+    const auto loadTime = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - loadStart);
+    std::println("Loaded {} textures in {:.1f} ms", textureData.texturePs.size(), loadTime.count());
 
-                        newRegions.push_back(copyRegion);
-                    }
-                }
-            },
-
-            [&](fastgltf::sources::BufferView& view) {
-                auto& bufferView = asset.bufferViews[view.bufferViewIndex];
-                auto& buffer = asset.buffers[bufferView.bufferIndex];
-
-                std::visit(
-                    fastgltf::visitor {
-                        [&](auto& arg) {},
-                        [&](fastgltf::sources::Array& array) {
-                            const auto ktxTextureBytes = reinterpret_cast<const ku8*>(array.bytes.data() + bufferView.byteOffset);
-                            const auto byteLength = static_cast<i32>(bufferView.byteLength);
-
-                            ktxTexture* texture;
-                            const ktxResult result = ktxTexture_CreateFromMemory(
-                                ktxTextureBytes,
-                                byteLength,
-                                KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT,
-                                &texture
-                                );
-
-                            if (result != KTX_SUCCESS)
-                                throw std::runtime_error("Failed to load KTX texture");
-
-                            const ku32 mipLevels = texture->numLevels;
-                            const ku32 textureSize = texture->dataSize;
-                            stagingBufferSize += textureSize;
-
-                            for (u32 i = 0; i < mipLevels; i++) {
-                                ku64 offset;
-                                if (ktxTexture_GetImageOffset(texture, i, 0, 0, &offset) == KTX_SUCCESS) {
-                                    vk::BufferImageCopy copyRegion;
-                                    copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-                                    copyRegion.imageSubresource.mipLevel = i;
-                                    copyRegion.imageSubresource.baseArrayLayer = 0;
-                                    copyRegion.imageSubresource.layerCount = 1;
-                                    copyRegion.imageExtent.width = std::max(1u, texture->baseWidth >> i);
-                                    copyRegion.imageExtent.height = std::max(1u, texture->baseHeight >> i);
-                                    copyRegion.imageExtent.depth = 1;
-                                    copyRegion.bufferOffset = offset;
-
-                                    newRegions.push_back(copyRegion);
-                                }
-                            }
-                        }
-                    }, buffer.data);
-            }
-        }, gltfImage.data);
+    return textureData;
+}
 
-        copyRegions.push_back(newRegions);
-    }
+void SceneBuilder::upload_scene_buffers(const GeometricData& geoData) const {
+    const auto stream = [](const auto& data) {
+        const auto bytes = reinterpret_cast<const u8*>(data.data());
+        return GeometryStream{data.size() * sizeof(*data.data()), [bytes](const u64 offset, const u64 size, u8* destination) {
+            memcpy(destination, bytes + offset, size);
+        }};
+    };
 
-    return {texturePs, copyRegions, stagingBufferSize};
+    upload_scene_buffers(GeometryStreams{
+        stream(geoData.get_vertex_data()),
+        stream(geoData.positions),
+        stream(geoData.indices),
+        stream(geoData.indices16),
+        stream(geoData.meshlets),
+        stream(geoData.meshletData)
+    });
 }
 
-void SceneBuilder::upload_scene_data(const GeometricData& geoData, ktxTextureData& ktxTextureData) const {
-    const auto geoStaging = prep_vertex_index_staging(geoData);
-    const auto imageStaging = prepare_image_staging(ktxTextureData);
+void SceneBuilder::upload_scene_buffers(const GeometryStreams& streams) const {
     const auto materialBuffer = prepare_material_buffer();
     const auto lightBuffer = prepare_light_buffer();
 
-    const auto& [vertexBuffer, indexBuffer, vertexBufferSize, indexBufferSize] = prep_geo_buffers(geoData);
+    const auto& [vertexBuffer, positionBuffer, indexBuffer, indexBuffer16, meshletBuffer, meshletDataBuffer] = prep_geo_buffers(streams);
 
     auto& lights = m_resourceData->lights;
     auto& materials = m_resourceData->materials;
-    auto& textures = m_resourceData->textures;
-    auto& regions = ktxTextureData.copyRegions;
 
-    CommandBuffer cmd;
-    cmd.set_handle(m_context.get_immediate_info().immediateCommandBuffer);
-    cmd.set_allocator(m_context.get_allocator());
-    cmd.begin();
+    // Everything is copied on the transfer queue, the frame loop only waits on the transfer timeline for the first
+    // frame that uses the results.
+    const auto& cmd = m_stagingRing->begin_segment();
     cmd.upload_uniform(lights.data(), lights.size(), lightBuffer);
     cmd.upload_uniform(materials.data(), materials.size(), materialBuffer);
-    cmd.copy_buffer(geoStaging, vertexBuffer, 0, 0, vertexBufferSize);
-    cmd.copy_buffer(geoStaging, indexBuffer, vertexBufferSize, 0, indexBufferSize);
-
-    u64 index = 0;
-    for (auto& texture : textures) {
-        const i64 mipLevels = texture.mipLevels;
-        cmd.image_barrier(texture.handle, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-        cmd.copy_buffer_to_image(
-            imageStaging,
-            texture,
-            vk::ImageLayout::eTransferDstOptimal,
-            regions[index]
-            );
-        cmd.image_barrier(texture.handle, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
-
-        index++;
-    }
-    cmd.end();
-
-    m_context.submit_upload_work();
-
-    /*m_context.submit_immediate_work([&](const CommandBuffer &cmd) {
-        cmd.upload_uniform(lights.data(), lights.size(), lightBuffer);
-        cmd.upload_uniform(materials.data(), materials.size(), materialBuffer);
-        cmd.copy_buffer(geoStaging, vertexBuffer, 0, 0, vertexBufferSize);
-        cmd.copy_buffer(imageStaging, indexBuffer, vertexBufferSize, 0, indexBufferSize);
-
-        i64 previousMipLevels = 0;
-        for (auto& texture : textures) {
-            const i64 mipLevels = texture.mipLevels;
-            cmd.image_barrier(texture.handle, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-            cmd.copy_buffer_to_image(
-                imageStaging,
-                texture,
-                vk::ImageLayout::eTransferDstOptimal,
-                std::span(
-                    regions.begin() + previousMipLevels,
-                    regions.end() + mipLevels)
-                );
-            cmd.image_barrier(texture.handle, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
-
-            previousMipLevels = mipLevels;
-        }
-    });*/
+    m_stagingRing->submit_segment();
+
+    m_stagingRing->upload_buffer(vertexBuffer, streams.vertices.size, streams.vertices.write);
+    m_stagingRing->upload_buffer(positionBuffer, streams.positions.size, streams.positions.write);
+    m_stagingRing->upload_buffer(indexBuffer, streams.indices.size, streams.indices.write);
+    m_stagingRing->upload_buffer(indexBuffer16, streams.indices16.size, streams.indices16.write);
+    m_stagingRing->upload_buffer(meshletBuffer, streams.meshlets.size, streams.meshlets.write);
+    m_stagingRing->upload_buffer(meshletDataBuffer, streams.meshletData.size, streams.meshletData.write);
 
     m_resourceData->indexBuffer = indexBuffer;
+    m_resourceData->indexBuffer16 = indexBuffer16;
+    m_resourceData->meshletBuffer = meshletBuffer;
+    m_resourceData->meshletDataBuffer = meshletDataBuffer;
     m_resourceData->vertexBuffer = vertexBuffer;
+    m_resourceData->positionBuffer = positionBuffer;
     m_resourceData->materialBuffer = materialBuffer;
     m_resourceData->lightBuffer = lightBuffer;
 }
 
-GeoBuffers SceneBuilder::prep_geo_buffers(const GeometricData &geoData) const {
-    GeoBuffers geoBuffers;
-    const auto& [vertices, indices] = geoData;
-    constexpr vk::BufferUsageFlags vertexBufferFlags =
-            vk::BufferUsageFlagBits::eStorageBuffer |
-            vk::BufferUsageFlagBits::eTransferDst |
-            vk::BufferUsageFlagBits::eVertexBuffer;
+void SceneBuilder::upload_textures(const std::span<const TextureUpload> uploads, const std::function<void(u64 index, u8* destination)>& readTexture) const {
+    const auto& textures = m_resourceData->textures;
+    const u64 firstTexture = textures.size() - uploads.size();
+    const u64 textureCount = uploads.size();
+
+    // Texture bytes are read straight into the mapped staging ring, one segment at a time, so peak memory is the ring
+    // size however large the scene is. BC7 copies need 16 byte aligned buffer offsets.
+    auto& stagingRing = *m_stagingRing;
+    std::vector<u64> offsets(textureCount);
+    std::vector<std::exception_ptr> errors(textureCount);
+
+    u64 next = 0;
+    while (next < textureCount) {
+        // Prefix sum over the texture sizes places as many textures as fit into the segment.
+        const u64 first = next;
+        u64 segmentSize = 0;
+        while (next < textureCount) {
+            const u64 size = (uploads[next].size + 15) & ~15ull;
+            if (segmentSize + size > stagingRing.get_segment_size())
+                break;
+            offsets[next] = segmentSize;
+            segmentSize += size;
+            next++;
+        }
 
-    constexpr vk::BufferUsageFlags indexBufferFlags =
-        vk::BufferUsageFlagBits::eStorageBuffer |
-            vk::BufferUsageFlagBits::eTransferDst |
-            vk::BufferUsageFlagBits::eIndexBuffer;
+        if (next == first)
+            throw std::runtime_error("Texture is larger than a staging ring segment");
 
-    const u64 vertexBufferSize = vertices.size() * sizeof(Vertex);
-    geoBuffers.vertexBufferSize = vertexBufferSize;
-    const u64 indexBufferSize = indices.size() * sizeof(u32);
-    geoBuffers.indexBufferSize = indexBufferSize;
+        auto& cmd = stagingRing.begin_segment();
+        u8* segmentData = stagingRing.get_segment_data();
 
-    geoBuffers.vertexBuffer = m_context.create_buffer(vertexBufferSize, vertexBufferFlags, VMA_MEMORY_USAGE_GPU_ONLY);
-    geoBuffers.indexBuffer = m_context.create_buffer(indexBufferSize, indexBufferFlags, VMA_MEMORY_USAGE_GPU_ONLY);
+        m_jobSystem.parallel_for(static_cast<u32>(next - first), [&](const u32 i, u32) {
+            try {
+                readTexture(first + i, segmentData + offsets[first + i]);
+            }
+            catch (...) {
+                errors[first + i] = std::current_exception();
+            }
+        });
 
-    return geoBuffers;
-}
+        for (u64 i = first; i < next; i++) {
+            if (errors[i])
+                continue;
 
-Buffer SceneBuilder::prep_vertex_index_staging(const GeometricData &geoData) const {
-    auto& [vertices, indices] = geoData;
-    const auto allocator = m_context.get_allocator();
-    const u64 vertexBufferSize = geoData.vertices.size() * sizeof(Vertex);
-    const u64 indexBufferSize = geoData.indices.size() * sizeof(u32);
-    const u64 stagingSize = vertexBufferSize + indexBufferSize;
-    const auto staging = m_context.create_staging_buffer(stagingSize);
-    auto data = staging.p_get_mapped_data();
+            std::vector<vk::BufferImageCopy> regions(uploads[i].regions.begin(), uploads[i].regions.end());
+            for (auto& region : regions)
+                region.bufferOffset += stagingRing.get_segment_offset() + offsets[i];
 
-    vmaMapMemory(allocator, staging.allocation, &data);
-    memcpy(data, vertices.data(), vertexBufferSize);
-    memcpy(static_cast<char*>(data) + vertexBufferSize, indices.data(), indexBufferSize);
-    vmaUnmapMemory(allocator, staging.allocation);
+            const auto& texture = textures[firstTexture + i];
+            cmd.image_barrier(texture.handle, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+            cmd.copy_buffer_to_image(stagingRing.get_buffer(), texture, vk::ImageLayout::eTransferDstOptimal, regions);
+            stagingRing.release_image(texture);
+        }
+
+        stagingRing.submit_segment();
 
-    return staging;
+        for (u64 i = first; i < next; i++)
+            if (errors[i])
+                std::rethrow_exception(errors[i]);
+    }
 }
 
-Buffer SceneBuilder::prepare_image_staging(const ktxTextureData &textureData) const {
-    auto& [texturePs, copyRegions, stagingSize] = textureData;
-    const auto allocator = m_context.get_allocator();
-    auto staging = m_context.create_staging_buffer(stagingSize);
-    auto data = staging.p_get_mapped_data();
+GeoBuffers SceneBuilder::prep_geo_buffers(const GeometryStreams& streams) const {
+    GeoBuffers geoBuffers;
+    constexpr vk::BufferUsageFlags vertexBufferFlags =
+            vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eTransferDst |
+            vk::BufferUsageFlagBits::eVertexBuffer;
 
-    std::vector<ku8> bytes;
-    bytes.resize(stagingSize);
+    constexpr vk::BufferUsageFlags indexBufferFlags =
+        vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eTransferDst |
+            vk::BufferUsageFlagBits::eIndexBuffer;
 
-    auto ptr = bytes.data();
-    for (const auto& texture : texturePs) {
-        const ku64 size = texture->dataSize;
-        const ku8* currentImageBytes = texture->pData;
-        memcpy(ptr, currentImageBytes, size);
-        ptr += size / sizeof(ku8);
+    constexpr vk::BufferUsageFlags storageBufferFlags =
+        vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eTransferDst;
 
-        ktxTexture_Destroy(texture);
-    }
+    // Scenes can leave either index buffer or the meshlet buffers empty, buffers are never created with a size of zero.
+    // Sizes are rounded up to whole words, triangle culling reads the 16 bit indices in pairs.
+    const auto create = [&](const GeometryStream& stream, const vk::BufferUsageFlags flags) {
+        return m_context.create_buffer(std::max<u64>((stream.size + 3) & ~3ull, sizeof(u32)), flags, VMA_MEMORY_USAGE_GPU_ONLY);
+    };
 
-    vmaMapMemory(allocator, staging.allocation, &data);
-    memcpy(data, bytes.data(), stagingSize);
-    vmaUnmapMemory(allocator, staging.allocation);
+    geoBuffers.vertexBuffer = create(streams.vertices, vertexBufferFlags);
+    geoBuffers.positionBuffer = create(streams.positions, vertexBufferFlags);
+    geoBuffers.indexBuffer = create(streams.indices, indexBufferFlags);
+    geoBuffers.indexBuffer16 = create(streams.indices16, indexBufferFlags);
+    geoBuffers.meshletBuffer = create(streams.meshlets, storageBufferFlags);
+    geoBuffers.meshletDataBuffer = create(streams.meshletData, storageBufferFlags);
 
-    return staging;
+    return geoBuffers;
 }
 
 Buffer SceneBuilder::prepare_material_buffer() const {
@@ -960,7 +2083,3 @@ Buffer SceneBuilder::prepare_light_buffer() const {
 
     return lightBuffer;
 }
-
-u16 SceneBuilder::get_metadata_at_index(const u32 index) const {
-    return m_resourceData->meshMetadata[index];
-}
@@ -1,13 +1,18 @@
 #pragma once
 #include "../common.h"
 #include "../device/context.h"
+#include "../device/stagingring.h"
 #include "../pipelines/descriptors.h"
 #include "../commands.h"
+#include "../jobsystem.h"
 #include "../glmdefines.h"
+#include "culling.h"
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/quaternion.hpp>
 
 #include <filesystem>
+#include <future>
+#include <mutex>
 
 #include <fastgltf/core.hpp>
 #include <fastgltf/types.hpp>
@@ -24,8 +29,36 @@ typedef ktx_int64_t ki64;
 typedef ktx_int32_t ki32;
 typedef ktx_int16_t ki16;
 
-typedef glm::vec4 Plane;
-typedef std::array<Plane, 5> Frustum;
+static constexpr u32 CULL_GROUP_SIZE = 64;
+static constexpr u32 CULL_CHUNK_SURFACES = 256;
+// Meshlet limits handed to meshopt_buildMeshlets, they size the mesh shader's outputs.
+static constexpr u32 MESHLET_MAX_VERTICES = 64;
+static constexpr u32 MESHLET_MAX_TRIANGLES = 124;
+// Meshlets tested by one task shader workgroup.
+static constexpr u32 TASK_GROUP_SIZE = 32;
+// Meshlets merged into one group for each simplification step of the cluster DAG, see SceneBuilder::build_cluster_lods().
+static constexpr u32 CLUSTER_GROUP_SIZE = 8;
+// Triangles tested by one triangle culling workgroup, every visible surface is split into batches of this many.
+static constexpr u32 TRIANGLE_BATCH_SIZE = 256;
+// Full detail plus up to four meshopt_simplify levels, each targeting half the triangles of the one before.
+static constexpr u32 MAX_SURFACE_LODS = 5;
+// Surfaces are not simplified below this many triangles.
+static constexpr u32 LOD_MIN_TRIANGLES = 64;
+// Largest meshopt_simplify error accepted for a level, relative to the surface's extent.
+static constexpr f32 LOD_MAX_ERROR = 0.1f;
+
+// Layout of the per frame draw count buffer in u32s. Draw counts are 16 bit index draws then 32 bit ones, the triangle
+// culling dispatches are VkDispatchIndirectCommands, the triangle counts are tested then kept and the LOD triangle
+// counts are drawn then full detail, both over both phases. The small culled count is of surfaces in the frustum that
+// were culled by their projected size.
+static constexpr u32 DRAW_COUNT_EARLY = 0;
+static constexpr u32 DRAW_COUNT_LATE = 2;
+static constexpr u32 DRAW_COUNT_EARLY_DISPATCH = 4;
+static constexpr u32 DRAW_COUNT_LATE_DISPATCH = 7;
+static constexpr u32 DRAW_COUNT_TRIANGLES = 10;
+static constexpr u32 DRAW_COUNT_LOD_TRIANGLES = 12;
+static constexpr u32 DRAW_COUNT_SMALL_CULLED = 14;
+static constexpr u32 DRAW_COUNT_SIZE = 15;
 
 struct AABB {
     glm::vec3 min{};
@@ -37,19 +70,94 @@ struct BoundingSphere {
     f32 radius{};
 };
 
+// One level of detail of a surface, a range of the surface's index buffer.
+struct SurfaceLod {
+    u32 initialIndex{};
+    u32 indexCount{};
+    // Largest deviation from the full detail surface, in the surface's local units.
+    f32 error{};
+    u32 padding{};
+};
+
 struct Surface {
     AABB boundingVolume;
+    // Into the index buffer of indexType. Indices are local to the surface, draws add firstVertex as their vertex offset.
+    // The full detail range, also lods[0].
     u32 initialIndex{};
     u32 indexCount{};
     MaterialHandle material{};
+    // Every surface owns the vertices [firstVertex, firstVertex + vertexCount).
+    u32 firstVertex{};
+    u32 vertexCount{};
+    // eUint16 whenever the surface has fewer than 65536 vertices.
+    vk::IndexType indexType = vk::IndexType::eUint32;
+    // Start and stride of the surface's vertices in 32 bit words, only used by VertexFormat::Packed.
+    u32 packedOffset{};
+    u32 packedStride{};
+    // The surface's meshlets, [firstMeshlet, firstMeshlet + meshletCount) of ResourceData::meshletBuffer.
+    u32 firstMeshlet{};
+    u32 meshletCount{};
+    // From the glTF material, backfaces are neither rasterizer culled nor triangle culled.
+    bool doubleSided = false;
+    // Full detail first, errors never decrease. Every level indexes the surface's own vertices and is stored after
+    // the full detail indices in the same index buffer.
+    std::array<SurfaceLod, MAX_SURFACE_LODS> lods{};
+    u32 lodCount = 1;
+};
+
+// One meshopt_buildMeshlets cluster of a surface. Bounds and cone are in the surface's local space. The meshlet faces
+// away from a camera at position p when dot(normalize(coneApex - p), coneAxis) >= coneCutoff, a cutoff of 1 never culls.
+struct Meshlet {
+    glm::vec3 center{};
+    f32 radius{};
+    glm::vec3 coneApex{};
+    f32 coneCutoff{};
+    glm::vec3 coneAxis{};
+    // Into the meshlet data buffer: vertexCount vertex indices local to the surface, followed by triangleCount
+    // triangles of three u8 meshlet vertex indices packed into a u32.
+    u32 dataOffset{};
+    u32 vertexCount{};
+    u32 triangleCount{};
+    // Cluster DAG terms, in local units: the error and bounding sphere (xyz centre, w radius) of the group this meshlet
+    // was simplified from, and of the group it was simplified into. A group's error is its own simplification error
+    // plus the largest its meshlets carry, so it accumulates towards the roots. Full detail meshlets have their own
+    // sphere and no error, the roots an infinite parent error. A meshlet is drawn when its own error projects within the threshold
+    // and its parent's does not.
+    f32 lodError{};
+    f32 parentError = std::numeric_limits<f32>::max();
+    glm::vec4 lodBounds{};
+    glm::vec4 parentBounds{};
 };
 
 struct GPUSurface {
-    glm::mat4 renderMatrix{};
-    AABB boundingVolume{};
+    glm::vec4 boundsCenter{};
+    // w is the radius of the bounding sphere around the box.
+    glm::vec4 boundsExtent{};
     u32 initialIndex{};
     u32 indexCount{};
     u32 materialIndex{};
+    u32 transformIndex{};
+    u32 firstVertex{};
+    u32 packedOffset{};
+    u32 packedStride{};
+    u32 firstMeshlet{};
+    u32 meshletCount{};
+    u32 doubleSided{};
+    // Start of the surface's range of the compacted index buffer, which triangle culling fills for its draw.
+    u32 compactedIndex{};
+    // Of the surface's MAX_SURFACE_LODS entries in the LOD buffer.
+    u32 lodCount{};
+};
+
+struct GPUDrawCommand {
+    vk::DrawIndexedIndirectCommand command{};
+    u32 surfaceIndex{};
+};
+
+// Meshlet counterpart of GPUDrawCommand, one task shader workgroup per TASK_GROUP_SIZE meshlets of the surface.
+struct GPUTaskCommand {
+    vk::DrawMeshTasksIndirectCommandEXT command{};
+    u32 surfaceIndex{};
 };
 
 struct Mesh {
@@ -64,6 +172,24 @@ struct Vertex {
     glm::vec4 colour{};
 };
 
+// Packed vertices are 3 words, or 4 when the surface has vertex colours:
+//   0: position x, y as unorm16 across the surface's bounding box
+//   1: position z as unorm16, octahedral normal as 2 snorm8
+//   2: uv as 2 halves
+//   3: colour as unorm8x4
+enum class VertexFormat : u32 {
+    Full, Packed
+};
+
+static constexpr u32 PACKED_VERTEX_WORDS = 3;
+static constexpr u32 PACKED_COLOUR_VERTEX_WORDS = 4;
+
+// The position stream holds every vertex's position again, indexed like the full vertex buffer, so depth only passes
+// read 12 bytes (Full: x, y, z as floats) or 8 bytes (Packed: words 0 and 1 of the packed vertex, normal bits cleared)
+// per vertex instead of the whole vertex.
+static constexpr u32 FULL_POSITION_WORDS = 3;
+static constexpr u32 PACKED_POSITION_WORDS = 2;
+
 enum class MaterialPass : u8 {
     Opaque, Transparent
 };
@@ -108,36 +234,160 @@ struct Light {
     f32 outerAngle{};
 };
 
-class SceneManager;
+static constexpr u32 NO_PARENT = std::numeric_limits<u32>::max();
 
+// Transforms live in ResourceData's node matrix arrays at the same index as the node.
 struct Node {
-    std::vector<NodeHandle> children;
-    glm::mat4 localMatrix{};
-    glm::mat4 worldMatrix{};
-
     NodeHandle parent{};
     MeshHandle mesh{};
     NodeHandle light{};
+};
+
+enum class CullingMode : u8 {
+    CPU, GPU, Validation
+};
+
+// Frustum culls everything in one pass. Early draws what was visible last frame, Late tests the remainder against
+// the depth pyramid built from the early pass and draws only the newly visible surfaces.
+enum class CullPhase : u32 {
+    Frustum, Early, Late
+};
+
+struct GPUCullData {
+    glm::mat4 viewProjection{};
+    Frustum frustum{};
+    glm::vec2 depthPyramidSize{};
+    u32 surfaceCount{};
+    // GPU surfaces below this index use 16 bit indices, see SceneManager::build_gpu_scene().
+    u32 surfaceCount16{};
+    glm::vec2 viewportSize{};
+    f32 pixelsPerUnit{};
+    f32 lodErrorThreshold{};
+    glm::vec3 cameraPosition{};
+    f32 minProjectedSize{};
+};
+
+// Camera terms of the LOD selection and the small surface culling, see SceneManager::select_lod() and
+// SceneManager::below_min_projected_size().
+struct LodView {
+    glm::vec3 cameraPosition{};
+    // Pixels covered by one world unit at a distance of one unit: projection[1][1] * viewportHeight / 2.
+    f32 pixelsPerUnit{};
+    // The coarsest LOD whose error projects to at most this many pixels is drawn.
+    f32 errorThreshold = 1.0f;
+    // Surfaces whose bounding sphere projects to a smaller diameter in pixels are culled, 0 keeps them all.
+    f32 minProjectedSize = 1.0f;
+};
+
+struct CullPushConstants {
+    vk::DeviceAddress surfaceBuffer;
+    vk::DeviceAddress transformBuffer;
+    vk::DeviceAddress drawBuffer;
+    vk::DeviceAddress drawCountBuffer;
+    vk::DeviceAddress cullDataBuffer;
+    vk::DeviceAddress visibilityBuffer;
+    vk::DeviceAddress taskBuffer;
+    vk::DeviceAddress triangleBatchBuffer;
+    vk::DeviceAddress triangleDispatchBuffer;
+    vk::DeviceAddress lodBuffer;
+    // LOD triangle counts of the draw count buffer.
+    vk::DeviceAddress lodTriangleBuffer;
+    // Small culled count of the draw count buffer.
+    vk::DeviceAddress smallCulledBuffer;
+    CullPhase phase;
+    // Writes GPUTaskCommands to taskBuffer instead of GPUDrawCommands to drawBuffer.
+    u32 taskDraws;
+    // Writes empty draws into the compacted index buffer and queues the surface's triangle batches for triangle culling.
+    u32 triangleCulling;
+};
+
+// One batch of TRIANGLE_BATCH_SIZE triangles of a visible surface's selected LOD, queued by the cull shader.
+struct GPUTriangleBatch {
+    u32 drawIndex{};
+    // The LOD's range of the index buffer.
+    u32 firstIndex{};
+    u32 triangleCount{};
+    u32 firstTriangle{};
+};
+
+struct TriangleCullPushConstants {
+    vk::DeviceAddress surfaceBuffer;
+    vk::DeviceAddress transformBuffer;
+    vk::DeviceAddress positionBuffer;
+    vk::DeviceAddress indexBuffer;
+    vk::DeviceAddress indexBuffer16;
+    vk::DeviceAddress drawBuffer;
+    vk::DeviceAddress triangleBatchBuffer;
+    vk::DeviceAddress compactedIndexBuffer;
+    vk::DeviceAddress cullDataBuffer;
+    vk::DeviceAddress triangleCountBuffer;
+    VertexFormat vertexFormat;
+};
 
-    auto refresh(const glm::mat4 &parentMatrix, SceneManager &sceneManager) -> void;
+// Contiguous run of GPU surfaces sharing an index type, culled and recorded by a single job.
+struct CullChunk {
+    u32 firstSurface{};
+    u32 surfaceCount{};
+    vk::IndexType indexType = vk::IndexType::eUint32;
 };
 
-struct Renderable {
-    Surface surface;
-    glm::mat4 worldMatrix{};
+// Contiguous run of node indices whose world matrices changed during an update.
+struct TransformRange {
+    u32 firstNode{};
+    u32 count{};
+};
+
+struct DrawRecordInfo {
+    std::span<CommandBuffer> workerCommandBuffers;
+    const Pipeline* pipeline{};
+    vk::Extent2D extent{};
+    vk::Format colorFormat{};
+    vk::Format depthFormat{};
+};
+
+struct CullingStats {
+    u32 totalDraws{};
+    u32 cpuVisibleDraws{};
+    u32 gpuVisibleDraws{};
+    u32 lateVisibleDraws{};
+    // Surfaces inside the frustum culled for projecting below the minimum size.
+    u32 cpuSmallCulledDraws{};
+    u32 gpuSmallCulledDraws{};
+    u32 validationMismatches{};
+    u32 testedTriangles{};
+    u32 keptTriangles{};
+    // Triangles of the drawn LODs, or with mesh shading of the selected clusters, and of the same draws at full
+    // detail. GPU culling only.
+    u32 lodTriangles{};
+    u32 fullDetailTriangles{};
 };
 
 struct PushConstants {
-    glm::mat4 renderMatrix;
+    // Read as Vertex or packed words depending on vertexFormat.
     vk::DeviceAddress vertexBuffer;
+    vk::DeviceAddress positionBuffer;
     vk::DeviceAddress materialBuffer;
     vk::DeviceAddress lightBuffer;
-    u32 materialIndex;
+    vk::DeviceAddress surfaceBuffer;
+    vk::DeviceAddress transformBuffer;
+    vk::DeviceAddress drawBuffer;
     u32 numLights;
+    VertexFormat vertexFormat;
+    // Only read by the meshlet pipeline, which culls meshlets against the frustum in cullDataBuffer.
+    vk::DeviceAddress taskBuffer;
+    vk::DeviceAddress meshletBuffer;
+    vk::DeviceAddress meshletDataBuffer;
+    vk::DeviceAddress cullDataBuffer;
+    // LOD triangle counts of the draw count buffer, the task shader adds the triangles of the clusters it selects.
+    vk::DeviceAddress lodTriangleBuffer;
 };
 
 
 struct Scene {
+    u32 firstNode{};
+    glm::mat4 rootMatrix{1.0f};
+    // Set when any node of the scene has a dirty local matrix, so static scenes skip update_nodes entirely.
+    bool transformsDirty = true;
     std::vector<NodeHandle> nodes;
     std::vector<NodeHandle> renderableNodes;
     std::vector<NodeHandle> opaqueNodes;
@@ -152,8 +402,8 @@ struct Scene {
 
 struct ktxTextureData {
     std::vector<ktxTexture*> texturePs;
+    // Relative to the start of each texture's data.
     std::vector<std::vector<vk::BufferImageCopy>> copyRegions;
-    u64 stagingBufferSize{};
 };
 
 struct ResourceData {
@@ -161,6 +411,12 @@ struct ResourceData {
     std::vector<u16> sceneMetadata;
     std::vector<Node> nodes;
     std::vector<u16> nodeMetadata;
+    // Parallel to nodes. Each scene's nodes are stored parent before child so world matrices resolve in one pass.
+    std::vector<glm::mat4> nodeLocalMatrices;
+    std::vector<glm::mat4> nodeWorldMatrices;
+    std::vector<u32> nodeParents;
+    // Set when a node's local matrix changed since the last update; the whole subtree is recomputed.
+    std::vector<u8> nodeDirty;
     std::vector<Mesh> meshes;
     std::vector<u16> meshMetadata;
     std::vector<Material> materials;
@@ -173,8 +429,13 @@ struct ResourceData {
     std::vector<u16> lightMetadata;
 
     std::string lightNames;
+    VertexFormat vertexFormat = VertexFormat::Full;
     Buffer vertexBuffer;
+    Buffer positionBuffer;
     Buffer indexBuffer;
+    Buffer indexBuffer16;
+    Buffer meshletBuffer;
+    Buffer meshletDataBuffer;
     Buffer materialBuffer;
     Buffer lightBuffer;
 };
@@ -182,18 +443,27 @@ struct ResourceData {
 class SceneManager {
 
 public:
-    explicit SceneManager(const std::shared_ptr<ResourceData>& resourceData)
-    : m_resourceData(resourceData) {
+    explicit SceneManager(const std::shared_ptr<ResourceData>& resourceData, JobSystem& jobSystem)
+    : m_resourceData(resourceData), m_jobSystem(jobSystem) {
         for (const auto& [surfaces] : m_resourceData->meshes)
             for (const auto& surface : surfaces)
                 numSurfaces++;
     };
 
-    void draw_scene(const CommandBuffer& cmd, SceneHandle handle, const glm::mat4& viewProjectionMatrix);
-    void cpu_frustum_culling(const Scene& scene, const glm::mat4& viewProjectionMatrix);
+    void build_gpu_scene(const Context& context, SceneHandle handle);
+    void cull_scene(CommandBuffer& cmd, SceneHandle handle, const glm::mat4& viewProjectionMatrix, u32 frameIndex,
+                    const Pipeline& cullPipeline, const glm::vec2& depthPyramidSize, const glm::vec2& viewportSize);
+    void cull_occluded(CommandBuffer& cmd, u32 frameIndex, const Pipeline& cullPipeline);
+    void cull_triangles(CommandBuffer& cmd, u32 frameIndex, const Pipeline& triangleCullPipeline, CullPhase phase = CullPhase::Early);
+    void record_scene(const DrawRecordInfo& recordInfo, const glm::mat4& viewProjectionMatrix, u32 frameIndex);
+    void draw_scene(const CommandBuffer& cmd, u32 frameIndex, CullPhase phase = CullPhase::Early);
+    u32 cpu_frustum_culling(const glm::mat4& viewProjectionMatrix, GPUDrawCommand* drawCommands);
+    void gpu_culling(const CommandBuffer& cmd, u32 frameIndex, CullPhase phase);
 
     [[nodiscard]] Scene& get_scene(SceneHandle handle) const;
     [[nodiscard]] Node& get_node(NodeHandle handle) const;
+    [[nodiscard]] const glm::mat4& get_local_matrix(NodeHandle handle) const;
+    [[nodiscard]] const glm::mat4& get_world_matrix(NodeHandle handle) const;
     [[nodiscard]] Light& get_light(LightHandle handle) const;
     [[nodiscard]] Material& get_material(MaterialHandle handle) const;
     [[nodiscard]] Mesh& get_mesh(MeshHandle handle) const;
@@ -202,16 +472,100 @@ public:
     [[nodiscard]] Light* get_all_lights_p() const { return m_resourceData->lights.data(); }
     [[nodiscard]] std::string& get_light_names() const { return m_resourceData->lightNames; }
     [[nodiscard]] u64 get_num_lights() const { return m_resourceData->lights.size(); }
+    [[nodiscard]] CullingMode get_culling_mode() const { return m_cullingMode; }
+    [[nodiscard]] const CullingStats& get_culling_stats() const { return m_cullingStats; }
+    [[nodiscard]] std::span<const TransformRange> get_changed_transforms() const { return m_changedTransforms; }
+    [[nodiscard]] bool get_occlusion_culling() const { return m_occlusionCulling; }
+    [[nodiscard]] bool occlusion_culling_active() const { return m_occlusionCulling && m_cullingMode == CullingMode::GPU; }
+    [[nodiscard]] bool records_secondary_commands() const { return m_cullingMode == CullingMode::CPU; }
+    [[nodiscard]] bool get_mesh_shading() const { return m_meshShading; }
+    // Meshlets are drawn from the GPU culling results, CPU culling records indexed draws.
+    [[nodiscard]] bool mesh_shading_active() const { return m_meshShading && m_cullingMode != CullingMode::CPU; }
+    [[nodiscard]] bool get_triangle_culling() const { return m_triangleCulling; }
+    [[nodiscard]] f32 get_lod_error_threshold() const { return m_lodView.errorThreshold; }
+    [[nodiscard]] f32 get_min_projected_size() const { return m_lodView.minProjectedSize; }
+    // Meshlets are culled by the task shader instead.
+    [[nodiscard]] bool triangle_culling_active() const {
+        return m_triangleCulling && m_cullingMode != CullingMode::CPU && !mesh_shading_active();
+    }
+
+    void set_local_matrix(NodeHandle handle, const glm::mat4& localMatrix);
+    void set_culling_mode(const CullingMode mode) { m_cullingMode = mode; }
+    // Only enable on devices with EXT_mesh_shader, see Device::supports_mesh_shading().
+    void set_mesh_shading(const bool enabled) { m_meshShading = enabled; }
+    // Called every frame before culling with the camera the scene is drawn from.
+    void set_lod_view(const glm::vec3& cameraPosition, const glm::mat4& projection, f32 viewportHeight);
+    void set_lod_error_threshold(const f32 pixels) { m_lodView.errorThreshold = pixels; }
+    void set_min_projected_size(const f32 pixels) { m_lodView.minProjectedSize = pixels; }
+    // Creates the compacted index buffers the first time it is enabled. Stays off when the scene has more triangle
+    // batches than one dispatch can cover.
+    void set_triangle_culling(const Context& context, bool enabled);
+    void set_occlusion_culling(const bool enabled) {
+        m_resetVisibility |= enabled && !m_occlusionCulling;
+        m_occlusionCulling = enabled;
+    }
 
     void update_light_buffer(const CommandBuffer& cmd) const;
-    void update_nodes(const glm::mat4& rootMatrix, SceneHandle handle);
+    u32 update_nodes(const glm::mat4& rootMatrix, SceneHandle handle);
     void release_gpu_resources(const Context& context) const;
+    void write_textures(DescriptorBuilder& builder) const;
 
 private:
     std::shared_ptr<ResourceData> m_resourceData;
-    std::vector<Renderable> m_renderables;
+    JobSystem& m_jobSystem;
+    std::vector<GPUSurface> m_gpuSurfaces;
+    // MAX_SURFACE_LODS per GPU surface, the first lodCount of them used.
+    std::vector<SurfaceLod> m_surfaceLods;
+    SurfaceBounds m_cullBounds;
+    std::vector<u32> m_visibleSurfaces;
+    std::vector<CullChunk> m_cullChunks;
+    std::vector<u32> m_chunkDrawCounts;
+    std::vector<u32> m_chunkSmallCulledCounts;
+    std::vector<vk::CommandBuffer> m_recordedCommandBuffers;
+    Buffer m_surfaceBuffer{};
+    Buffer m_lodBuffer{};
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> m_transformBuffers{};
+    // Each frame's transform buffer is only written when that frame is recorded, so changes queue per frame.
+    std::array<std::vector<TransformRange>, MAX_FRAMES_IN_FLIGHT> m_pendingTransforms{};
+    std::vector<TransformRange> m_changedTransforms;
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> m_drawBuffers{};
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> m_culledDrawBuffers{};
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> m_lateDrawBuffers{};
+    // Early task commands followed by the late ones, each range numSurfaces long.
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> m_taskBuffers{};
+    // Only created while triangle culling is enabled. Every surface owns the range of its index count from its
+    // compactedIndex on, early and late draws never share a surface so both phases write the same buffer.
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> m_compactedIndexBuffers{};
+    // Early batches followed by the late ones, each range m_triangleBatchCount long.
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> m_triangleBatchBuffers{};
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> m_drawCountBuffers{};
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> m_cullDataBuffers{};
+    std::array<u32, MAX_FRAMES_IN_FLIGHT> m_cpuDrawCounts{};
+    std::array<CullingMode, MAX_FRAMES_IN_FLIGHT> m_frameCullingModes{};
+    Buffer m_visibilityBuffer{};
+    CullingMode m_cullingMode = CullingMode::GPU;
+    bool m_occlusionCulling = true;
+    bool m_meshShading = false;
+    bool m_triangleCulling = false;
+    bool m_resetVisibility = true;
+    LodView m_lodView{};
+    CullingStats m_cullingStats{};
     PushConstants pc{};
+    CullPushConstants cullPc{};
     u64 numSurfaces = 0;
+    // Surfaces with 16 bit indices come first in m_gpuSurfaces and in every draw buffer.
+    u32 m_surfaceCount16 = 0;
+    // Totals over every GPU surface, they size the triangle culling buffers.
+    u64 m_surfaceIndexCount = 0;
+    u32 m_triangleBatchCount = 0;
+
+    void upload_transforms(u32 frameIndex);
+    void update_push_constants(u32 frameIndex, const Buffer& drawBuffer);
+    void create_triangle_culling_buffers(const Context& context);
+    void draw_meshlets(const CommandBuffer& cmd, u32 frameIndex, CullPhase phase);
+    u32 cull_chunk(const Frustum& frustum, u32 chunkIndex, GPUDrawCommand* drawCommands);
+    [[nodiscard]] u32 select_lod(u32 surfaceIndex, const BoundingSphere& worldSphere, f32 worldScale) const;
+    [[nodiscard]] bool below_min_projected_size(const BoundingSphere& worldSphere) const;
 
     void assert_handle(SceneHandle handle) const;
     void assert_handle(NodeHandle handle) const;
@@ -225,47 +579,189 @@ private:
 struct GeometricData {
     std::vector<Vertex> vertices;
     std::vector<u32> indices;
+    std::vector<u16> indices16;
+    // Replaces vertices when the scene uses VertexFormat::Packed.
+    std::vector<u32> packedVertices;
+    // FULL_POSITION_WORDS or PACKED_POSITION_WORDS per vertex.
+    std::vector<u32> positions;
+    std::vector<Meshlet> meshlets;
+    // Vertex indices and packed triangles of every meshlet, see Meshlet::dataOffset.
+    std::vector<u32> meshletData;
+
+    [[nodiscard]] std::span<const u8> get_vertex_data() const {
+        if (!packedVertices.empty())
+            return {reinterpret_cast<const u8*>(packedVertices.data()), packedVertices.size() * sizeof(u32)};
+        return {reinterpret_cast<const u8*>(vertices.data()), vertices.size() * sizeof(Vertex)};
+    }
+};
+
+struct SceneImportOptions {
+    // Runs the meshoptimizer pass of SceneBuilder::optimize_surface() on every surface.
+    bool optimizeMeshes = false;
+    // Simplifies every surface into its LOD chain, see SceneBuilder::build_lods().
+    bool generateLods = true;
+    // Simplifies every surface's meshlets into a cluster DAG, see SceneBuilder::build_cluster_lods().
+    bool buildClusterLods = true;
+    // Stores the vertices as VertexFormat::Packed.
+    bool packVertices = false;
+    // Prints the MeshImportStats of the import once every mesh is converted.
+    bool printStats = false;
+};
+
+// Totals over every optimized surface. ACMR is transformedVertices / triangles, overdraw shadedPixels / coveredPixels.
+struct MeshOptimizationStats {
+    u64 surfaceCount{};
+    u64 triangleCount{};
+    u64 verticesBefore{};
+    u64 verticesAfter{};
+    u64 transformedVerticesBefore{};
+    u64 transformedVerticesAfter{};
+    u64 coveredPixels{};
+    u64 shadedPixelsBefore{};
+    u64 shadedPixelsAfter{};
+};
+
+// What SceneBuilder::create_meshes() produced, gathered over the whole import and printed in one block.
+struct MeshImportStats {
+    MeshOptimizationStats optimization;
+    u64 indexCount16{};
+    u64 indexCount32{};
+    u64 meshletCount{};
+    u64 fullDetailMeshletCount{};
+    u64 meshletBytes{};
+    u64 lodTriangleCount{};
+    u64 vertexCount{};
+    u64 fullVertexBytes{};
+    u64 packedVertexBytes{};
+};
+
+struct SamplerInfo {
+    vk::Filter magFilter{};
+    vk::Filter minFilter{};
+    vk::SamplerMipmapMode mipmapMode{};
+};
+
+struct TextureInfo {
+    u32 width{};
+    u32 height{};
+    u32 levelCount{};
+};
+
+// One texture's staged data: size bytes copied with regions relative to the start of the data.
+struct TextureUpload {
+    u64 size{};
+    std::span<const vk::BufferImageCopy> regions;
+};
+
+// Size in bytes of one geometry buffer, and the write filling it one staging segment at a time.
+struct GeometryStream {
+    u64 size{};
+    StagingWrite write;
+};
+
+struct GeometryStreams {
+    GeometryStream vertices;
+    GeometryStream positions;
+    GeometryStream indices;
+    GeometryStream indices16;
+    GeometryStream meshlets;
+    GeometryStream meshletData;
 };
 
 struct GeoBuffers {
     Buffer vertexBuffer{};
+    Buffer positionBuffer{};
     Buffer indexBuffer{};
-    u64 vertexBufferSize = 0;
-    u64 indexBufferSize = 0;
+    Buffer indexBuffer16{};
+    Buffer meshletBuffer{};
+    Buffer meshletDataBuffer{};
+};
+
+// A scene built into its own ResourceData whose GPU uploads have completed, ready to be published to the SceneManager.
+struct LoadedScene {
+    std::shared_ptr<ResourceData> resourceData;
+    SceneHandle scene{};
 };
 
+class CookedScene;
+
 class SceneBuilder {
 public:
-    explicit SceneBuilder(Context& context, const std::shared_ptr<ResourceData>& resourceData);
+    // importOptions apply to every glTF scene this builder imports.
+    explicit SceneBuilder(Context& context, JobSystem& jobSystem, const SceneImportOptions& importOptions = {});
 
-    [[nodiscard]] std::optional<fastgltf::Asset> parse_gltf(const std::filesystem::path& path) const;
+    [[nodiscard]] static std::optional<fastgltf::Asset> parse_gltf(const std::filesystem::path& path);
     std::optional<SceneHandle> build_scene(fastgltf::Asset& asset);
+    std::optional<SceneHandle> build_scene(const CookedScene& cookedScene);
 
-    void write_textures(DescriptorBuilder& builder) const;
+    // Converts a glTF scene and its KTX2 textures into the cooked format (scenes/cookedscene.h) offline, no device needed.
+    static void cook_scene(const std::filesystem::path& gltfPath, const std::filesystem::path& outputPath, JobSystem& jobSystem, const SceneImportOptions& importOptions = {});
+
+    // Builds and uploads the scene at path into a fresh ResourceData and waits for its transfers, throwing on failure.
+    // Paths ending in COOKED_SCENE_EXTENSION are mapped as cooked scenes, anything else is parsed as glTF. Loads are
+    // serialized, a second load waits for the first.
+    LoadedScene load_scene(const std::filesystem::path& path);
+    // Runs load_scene on a background thread. The future becomes ready once the scene can be rendered, errors are
+    // rethrown by get().
+    [[nodiscard]] std::future<LoadedScene> load_scene_async(std::filesystem::path path);
 
 private:
     Context& m_context;
+    // Target of the scene currently being built.
     std::shared_ptr<ResourceData> m_resourceData;
-
-    void create_nodes(const fastgltf::Asset& asset, Scene& scene) const;
-    GeometricData create_meshes(const fastgltf::Asset& asset, Scene& scene) const;
-    void create_materials(const fastgltf::Asset& asset, Scene& scene) const;
-    void create_samplers(const fastgltf::Asset& asset, Scene& scene) const;
-    void create_lights(const fastgltf::Asset& asset, Scene& scene) const;
-    void create_images(const std::vector<ktxTexture*>& ktxTexturePs, Scene& scene) const;
-
-    ktxTextureData ktx_texture_data_from_gltf(fastgltf::Asset& asset);
-
-    void upload_scene_data(const GeometricData& geoData, ktxTextureData& ktxTextureData) const;
-
-    [[nodiscard]] GeoBuffers prep_geo_buffers(const GeometricData& geoData) const;
-    [[nodiscard]] Buffer prep_vertex_index_staging(const GeometricData& geoData) const;
-    [[nodiscard]] Buffer prepare_image_staging(const ktxTextureData& textureData) const;
+    JobSystem& m_jobSystem;
+    std::mutex m_loadMutex;
+    // Kept alive between scenes so uploads never wait for the ring to drain.
+    std::unique_ptr<StagingRing> m_stagingRing;
+    SceneImportOptions m_importOptions;
+
+    // The glTF conversion only touches CPU side data, so cooking can run it without a device.
+    static void create_nodes(const fastgltf::Asset& asset, Scene& scene, ResourceData& resourceData);
+    static GeometricData create_meshes(const fastgltf::Asset& asset, Scene& scene, ResourceData& resourceData, const SceneImportOptions& importOptions);
+    static void print_import_stats(const MeshImportStats& stats, const SceneImportOptions& importOptions);
+    // Deduplicates the vertices appended for the surface, then reorders its triangles for the post transform cache and
+    // overdraw and its vertices for fetch locality. surfaceIndices are local to the surface, vertices shrinks to the
+    // unique count.
+    static void optimize_surface(std::vector<Vertex>& vertices, std::span<u32> surfaceIndices, u64 firstVertex, MeshOptimizationStats& stats);
+    // Rewrites strip and fan indices as a triangle list, the only topology the pipelines and meshlets handle. Degenerate
+    // triangles, which strips use to restart, are dropped.
+    static void triangulate_surface(fastgltf::PrimitiveType type, std::vector<u32>& surfaceIndices);
+    // Appends the surface's vertices to packedVertices in VertexFormat::Packed and sets its packed offset and stride.
+    static void pack_surface(std::span<const Vertex> vertices, Surface& surface, bool hasColour, std::vector<u32>& packedVertices);
+    // Splits the surface's triangles into meshlets with bounds and normal cones and sets its meshlet range. Double sided
+    // surfaces get cones that never cull.
+    static void build_meshlets(std::span<const Vertex> vertices, std::span<const u32> surfaceIndices, Surface& surface,
+                               std::vector<Meshlet>& meshlets, std::vector<u32>& meshletData);
+    // Grows the surface's meshlets into a DAG of coarser clusters appended to its meshlet range: neighbouring meshlets
+    // are grouped, each group is simplified to half its triangles with its boundary locked and split into new
+    // meshlets, until a single cluster is left or no group simplifies any further.
+    static void build_cluster_lods(std::span<const Vertex> vertices, Surface& surface, std::vector<Meshlet>& meshlets,
+                                   std::vector<u32>& meshletData);
+    // Appends the simplified levels of the surface to lodIndices and adds them to its LOD table, with initial indices
+    // relative to the start of the surface's full detail indices, which lodIndices is stored right after. Borders are
+    // locked so neighbouring surfaces at different levels do not crack apart.
+    static void build_lods(std::span<const Vertex> vertices, std::span<const u32> surfaceIndices, Surface& surface, std::vector<u32>& lodIndices);
+    static void create_materials(const fastgltf::Asset& asset, Scene& scene, ResourceData& resourceData);
+    static void create_lights(const fastgltf::Asset& asset, Scene& scene, ResourceData& resourceData);
+    static std::vector<SamplerInfo> create_sampler_infos(const fastgltf::Asset& asset, Scene& scene, ResourceData& resourceData);
+    static std::vector<TextureInfo> create_texture_infos(const std::vector<ktxTexture*>& ktxTexturePs, Scene& scene, ResourceData& resourceData);
+    void create_samplers(std::span<const SamplerInfo> samplerInfos) const;
+    void create_images(std::span<const TextureInfo> textureInfos) const;
+    SceneHandle add_scene(Scene&& scene) const;
+
+    static ktxTextureData ktx_texture_data_from_gltf(const fastgltf::Asset& asset, JobSystem& jobSystem);
+    [[nodiscard]] static ktxTexture* load_ktx_texture(const fastgltf::Asset& asset, const fastgltf::Image& image);
+
+    void upload_scene_buffers(const GeometricData& geoData) const;
+    void upload_scene_buffers(const GeometryStreams& streams) const;
+    // Streams the last uploads.size() textures through the staging ring. readTexture(i, destination) writes texture
+    // i's data into staging memory and runs on job system workers, an exception it throws is rethrown here.
+    void upload_textures(std::span<const TextureUpload> uploads, const std::function<void(u64 index, u8* destination)>& readTexture) const;
+
+    [[nodiscard]] GeoBuffers prep_geo_buffers(const GeometryStreams& streams) const;
     [[nodiscard]] Buffer prepare_material_buffer() const;
     [[nodiscard]] Buffer prepare_light_buffer() const;
 
-    [[nodiscard]] u16 get_metadata_at_index(u32 index) const;
-
 };
 
 template<typename T>
@@ -283,5 +779,4 @@ u32 get_handle_metadata(const T handle) {
     return (handleAsU32 & metaDataMask) >> 16;
 }
 
-Frustum compute_frustum(const glm::mat4& viewProjection);
 AABB recompute_aabb(const AABB& oldAABB, const glm::mat4& transform);
@@ -0,0 +1,16 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+#extension GL_ARB_shading_language_include : require
+#include "resources.glsl"
+
+// Depth only variant of vertex.vert that reads nothing but the position stream.
+invariant gl_Position;
+
+void main() {
+    DrawCommand draw = PushConstants.drawBuffer.drawCommands[gl_DrawID];
+    Surface surface = PushConstants.surfaceBuffer.surfaces[draw.surfaceIndex];
+    mat4 renderMatrix = PushConstants.transformBuffer.transforms[surface.transformIndex];
+
+    vec4 position = vec4(load_position(gl_VertexIndex, surface), 1.0f);
+    gl_Position = sceneData.projection * sceneData.view * renderMatrix * position;
+}
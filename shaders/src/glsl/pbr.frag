@@ -7,6 +7,7 @@ layout (location = 0) in vec4 inColor;
 layout (location = 1) in vec2 inUV;
 layout (location = 2) in vec3 inNormal;
 layout (location = 3) in vec3 inFragPosition;
+layout (location = 4) flat in uint inMaterialIndex;
 
 layout (location = 0) out vec4 outFragColor;
 
@@ -43,7 +44,7 @@ vec3 fresnelSchlick(float normalHalfwayIncidence, vec3 F0) {
 void main() {
     MaterialBuffer mb = PushConstants.materialBuffer;
     LightBuffer lb = PushConstants.lightBuffer;
-    Material material = mb.materials[PushConstants.materialIndex];
+    Material material = mb.materials[inMaterialIndex];
     vec4 baseColourTextureColour = texture(Textures[material.baseColorTexture], inUV);
     vec3 albedo = baseColourTextureColour.rgb;
 
@@ -1,6 +1,10 @@
 #extension GL_EXT_nonuniform_qualifier : require
 #extension GL_EXT_buffer_reference : require
 #define PI 3.1415926538
+#define VERTEX_FORMAT_FULL 0
+#define VERTEX_FORMAT_PACKED 1
+#define FULL_POSITION_WORDS 3
+#define PACKED_POSITION_WORDS 2
 
 struct Vertex {
     vec3 position;
@@ -32,10 +36,44 @@ struct Light {
     float outerAngle;
 };
 
+struct Surface {
+    vec4 boundsCenter;
+    vec4 boundsExtent;
+    uint initialIndex;
+    uint indexCount;
+    uint materialIndex;
+    uint transformIndex;
+    uint firstVertex;
+    uint packedOffset;
+    uint packedStride;
+    uint firstMeshlet;
+    uint meshletCount;
+    uint doubleSided;
+    uint compactedIndex;
+    uint lodCount;
+};
+
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+    uint surfaceIndex;
+};
+
 layout(buffer_reference, std430) readonly buffer VertexBuffer {
     Vertex vertices[];
 };
 
+layout(buffer_reference, std430) readonly buffer PackedVertexBuffer {
+    uint words[];
+};
+
+layout(buffer_reference, std430) readonly buffer PositionBuffer {
+    uint words[];
+};
+
 layout(buffer_reference, std430) readonly buffer MaterialBuffer {
     Material materials[];
 };
@@ -44,17 +82,52 @@ layout(buffer_reference, std430) readonly buffer LightBuffer {
     Light lights[];
 };
 
+layout(buffer_reference, std430) readonly buffer SurfaceBuffer {
+    Surface surfaces[];
+};
+
+layout(buffer_reference, std430) readonly buffer TransformBuffer {
+    mat4 transforms[];
+};
+
+layout(buffer_reference, std430) readonly buffer DrawBuffer {
+    DrawCommand drawCommands[];
+};
+
 layout( push_constant ) uniform constants {
-    mat4 renderMatrix;
+    // Holds packed words instead when vertexFormat is VERTEX_FORMAT_PACKED.
     VertexBuffer vertexBuffer;
+    PositionBuffer positionBuffer;
     MaterialBuffer materialBuffer;
     LightBuffer lightBuffer;
-    uint materialIndex;
+    SurfaceBuffer surfaceBuffer;
+    TransformBuffer transformBuffer;
+    DrawBuffer drawBuffer;
     uint numLights;
+    uint vertexFormat;
 } PushConstants;
 
 layout(binding = 0) uniform SceneData {
     mat4 view;
     mat4 projection;
     vec3 cameraPosition;
-} sceneData;
\ No newline at end of file
+} sceneData;
+
+// Packed positions are relative to the surface's bounds.
+vec3 dequantize_position(uint word0, uint word1, Surface surface) {
+    vec3 quantized = vec3(word0 & 0xffffu, word0 >> 16, word1 & 0xffffu) / 65535.0;
+    vec3 boundsMin = surface.boundsCenter.xyz - surface.boundsExtent.xyz;
+    return boundsMin + quantized * 2.0 * surface.boundsExtent.xyz;
+}
+
+// Reads only the position stream, the result matches the position load_vertex() returns exactly.
+vec3 load_position(uint vertexID, Surface surface) {
+    PositionBuffer positions = PushConstants.positionBuffer;
+    if (PushConstants.vertexFormat == VERTEX_FORMAT_FULL) {
+        uint base = vertexID * FULL_POSITION_WORDS;
+        return uintBitsToFloat(uvec3(positions.words[base], positions.words[base + 1], positions.words[base + 2]));
+    }
+
+    uint base = vertexID * PACKED_POSITION_WORDS;
+    return dequantize_position(positions.words[base], positions.words[base + 1], surface);
+}
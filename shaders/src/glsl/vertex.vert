@@ -1,4 +1,4 @@
-#version 450
+#version 460
 #extension GL_GOOGLE_include_directive : require
 #extension GL_ARB_shading_language_include : require
 #include "resources.glsl"
@@ -7,16 +7,52 @@ layout (location = 0) out vec4 outColor;
 layout (location = 1) out vec2 outUV;
 layout (location = 2) out vec3 outNormal;
 layout (location = 3) out vec3 outFragPosition;
+layout (location = 4) flat out uint outMaterialIndex;
+
+// Depth from depth.vert has to match exactly.
+invariant gl_Position;
+
+vec3 octahedral_decode(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = clamp(-normal.z, 0.0, 1.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+    return normalize(normal);
+}
+
+Vertex load_vertex(uint vertexID, Surface surface) {
+    if (PushConstants.vertexFormat == VERTEX_FORMAT_FULL)
+        return PushConstants.vertexBuffer.vertices[vertexID];
+
+    PackedVertexBuffer pb = PackedVertexBuffer(PushConstants.vertexBuffer);
+    uint base = surface.packedOffset + (vertexID - surface.firstVertex) * surface.packedStride;
+    uint word0 = pb.words[base];
+    uint word1 = pb.words[base + 1];
+    uint word2 = pb.words[base + 2];
+
+    Vertex v;
+    v.position = dequantize_position(word0, word1, surface);
+    v.normal = octahedral_decode(unpackSnorm4x8(word1).zw);
+    vec2 uv = unpackHalf2x16(word2);
+    v.uv_x = uv.x;
+    v.uv_y = uv.y;
+    v.color = surface.packedStride > 3 ? unpackUnorm4x8(pb.words[base + 3]) : vec4(1.0);
+    return v;
+}
 
 void main() {
-    VertexBuffer vb = PushConstants.vertexBuffer;
-    Vertex v = vb.vertices[gl_VertexIndex];
+    DrawCommand draw = PushConstants.drawBuffer.drawCommands[gl_DrawID];
+    Surface surface = PushConstants.surfaceBuffer.surfaces[draw.surfaceIndex];
+    mat4 renderMatrix = PushConstants.transformBuffer.transforms[surface.transformIndex];
+
+    Vertex v = load_vertex(gl_VertexIndex, surface);
     vec4 position = vec4(v.position, 1.0f);
 
-    gl_Position = sceneData.projection * sceneData.view * PushConstants.renderMatrix * position;
+    gl_Position = sceneData.projection * sceneData.view * renderMatrix * position;
 
     outNormal = v.normal;
     outColor = v.color;
     outUV = vec2(v.uv_x, v.uv_y);
-    outFragPosition = vec3(PushConstants.renderMatrix * position);
+    outFragPosition = vec3(renderMatrix * position);
+    outMaterialIndex = surface.materialIndex;
 }
\ No newline at end of file